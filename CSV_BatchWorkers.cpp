@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_BatchWorkers.cpp
+//!
+//! @brief		Implementation for the CSV_BatchWorkers class
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "CSV_BatchWorkers.h"			// Batch workers class header
+///////////////////////////////////////////////////////////////////////////////
+
+CSV_BatchWorkers::CSV_BatchWorkers(const size_t threads, const size_t slots, std::function<void(const size_t slot)> work)
+{
+	mWork = std::move(work);
+	mSlots = slots > 0 ? slots : 1;
+	mDone.assign(mSlots, 0);
+	mSubmitted = 0;
+	mTaken = 0;
+	mStop = false;
+
+	size_t count = threads > 0 ? threads : 1;
+	for (size_t i = 0; i < count; i++)
+	{
+		mThreads.emplace_back(&CSV_BatchWorkers::Worker, this);
+	}
+}
+
+CSV_BatchWorkers::~CSV_BatchWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mStop = true;
+	}
+	mQueued.notify_all();
+	for (std::thread& thread : mThreads)
+	{
+		thread.join();
+	}
+}
+
+bool CSV_BatchWorkers::Full() const
+{
+	return mSubmitted - mTaken >= mSlots;
+}
+
+size_t CSV_BatchWorkers::Free() const
+{
+	return (size_t)(mSubmitted % mSlots);
+}
+
+void CSV_BatchWorkers::Submit()
+{
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		size_t slot = Free();
+		mDone[slot] = 0;
+		mQueue.push_back(slot);
+		mSubmitted++;
+	}
+	mQueued.notify_one();
+}
+
+bool CSV_BatchWorkers::Take(size_t& slot, const bool wait)
+{
+	if (mTaken == mSubmitted)
+	{
+		return false;
+	}
+
+	// Batches come back in the order they went in, a later batch finishing first waits its turn.
+	std::unique_lock<std::mutex> lock(mLock);
+	size_t oldest = (size_t)(mTaken % mSlots);
+	if (!mDone[oldest])
+	{
+		if (!wait)
+		{
+			return false;
+		}
+		mFinished.wait(lock, [this, oldest] { return mDone[oldest] != 0; });
+	}
+
+	mTaken++;
+	slot = oldest;
+	return true;
+}
+
+void CSV_BatchWorkers::Worker()
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	while (true)
+	{
+		mQueued.wait(lock, [this] { return mStop || !mQueue.empty(); });
+		if (mStop)
+		{
+			return;
+		}
+
+		size_t slot = mQueue.front();
+		mQueue.pop_front();
+		lock.unlock();
+		mWork(slot);
+		lock.lock();
+		mDone[slot] = 1;
+		mFinished.notify_all();
+	}
+}
@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_BatchWorkers.h
+//!
+//! @brief		A fixed set of worker threads fed batches through a bounded queue, handed back in order.
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <condition_variable>			// Waiting on batches
+#include <cstdint>						// Batch counters
+#include <deque>						// Queued batches
+#include <functional>					// Batch work
+#include <mutex>						// Data protection
+#include <thread>						// Workers
+#include <vector>                       // Vectors
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! @brief Runs batches on worker threads started once, while the calling thread fills and drains them.
+//! @note Batches live in a fixed number of slots owned by the caller. The caller fills the free slot,
+//!		  submits it, and takes finished batches back in the order they were submitted, so reading
+//!		  the next batch and writing the last one overlap the work on the others.
+//!		  ex. while (more) { while (workers.Take(slot, workers.Full())) { Write(slot); } Fill(workers.Free()); workers.Submit(); }
+class CSV_BatchWorkers
+{
+public:
+	//! @brief Overloaded Constructor, starts the workers.
+	//! @param threads - [in] - number of worker threads, at least 1.
+	//! @param slots - [in] - the most batches in flight, at least 1.
+	//! @param work - [in] - function run on a worker for each submitted slot.
+	CSV_BatchWorkers(const size_t threads, const size_t slots, std::function<void(const size_t slot)> work);
+
+	//! @brief Default Deconstructor, stops the workers. Batches not started yet are dropped.
+	~CSV_BatchWorkers();
+
+	//! @brief Check if every slot is in flight.
+	//! @return bool: true if no slot is free until a batch is taken back, else false.
+	bool Full() const;
+
+	//! @brief Get the slot for the next batch.
+	//! @note Only valid while Full() is false.
+	//! @return size_t: the free slot.
+	size_t Free() const;
+
+	//! @brief Hand the free slot to the workers.
+	void Submit();
+
+	//! @brief Take back the oldest batch once it is finished.
+	//! @param slot - [out] - the slot of the batch taken back.
+	//! @param wait - [in] - true to wait for the oldest batch to finish, false to return if it hasn't.
+	//! @return bool: true if a batch was taken back, false if none is in flight or the oldest isn't finished.
+	bool Take(size_t& slot, const bool wait);
+
+private:
+	//! @brief Worker thread, runs queued slots until stopped.
+	void Worker();
+
+	std::function<void(const size_t)>	mWork;			//!< Work run for each slot
+	std::vector<std::thread>			mThreads;		//!< Workers
+	std::mutex							mLock;			//!< Protects the queue and finished flags
+	std::condition_variable				mQueued;		//!< Signals a queued slot or stop
+	std::condition_variable				mFinished;		//!< Signals a finished slot
+	std::deque<size_t>					mQueue;			//!< Slots waiting for a worker
+	std::vector<char>					mDone;			//!< Finished flag of each slot
+	size_t								mSlots;			//!< Number of slots
+	uint64_t							mSubmitted;		//!< Batches submitted
+	uint64_t							mTaken;			//!< Batches taken back
+	bool								mStop;			//!< Workers should exit
+};
@@ -17,6 +17,11 @@
 //          --------------------        ---------------------------------------
 #include <string>                       // strings
 #include <vector>                       // vectors
+#include <cstdint>                      // 64 bit row counts and sizes
+#include <cstdio>                       // Output streams for rendering
+#include <ostream>                      // Printing the file info
+//
+#include "CSV_Profile.h"                // Column profiles
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -27,17 +32,19 @@ public:
     std::string filename;					// Filename 
     std::vector<std::string> col_names;		// CSV column names 
     char delimiter;							// Delimiting character 
-    int n_rows;							    // Number of rows in a file 
+    int64_t n_rows;							// Number of rows in a file 
     int n_cols;							    // Number of columns in a CSV 
-    size_t filesize;						// Size of the file in bytes
+    uint64_t filesize;						// Size of the file in bytes
+    std::vector<CSVColumnProfile> profiles;	// Column profiles from CSV_Utility::Profile, empty until profiled
+    std::string spill_file;                 // Spill file of the last ParseAnyCSVFile into a row store, empty if it fit in memory
 
     // constructor initializes everything
     CSVFileInfo(std::string filename = "",
                 std::vector<std::string> col_names = {},
                 char delimiter = '\0',
-                int n_rows = 0,
+                int64_t n_rows = 0,
                 int n_cols = 0,
-                size_t filesize = 0) :
+                uint64_t filesize = 0) :
                 filename(filename), col_names(col_names), delimiter(delimiter),
                 n_rows(n_rows), n_cols(n_cols), filesize(filesize)
 
@@ -70,10 +77,101 @@ public:
 
         os << "\tFile Size:         " << csv.filesize << "\n";
 
+        if (!csv.spill_file.empty())
+        {
+            os << "\tSpill File:        " << csv.spill_file << "\n";
+        }
+
         return os;
     }
 };
 
+//! @brief Statistics of one column within a block of rows.
+class CSVColumnStats
+{
+public:
+    std::string min;                        // Smallest non-empty value
+    std::string max;                        // Largest non-empty value
+    int64_t nulls;                          // Number of empty or missing values
+    bool numeric;                           // True if every non-empty value is a number, min/max then compare numerically
+
+    // constructor initializes everything
+    CSVColumnStats() : nulls(0), numeric(true) {}
+};
+
+//! @brief One block of rows in a row index.
+class CSVBlockInfo
+{
+public:
+    int64_t first_row;                      // First row in the block (starting at 1)
+    int64_t n_rows;                         // Number of rows in the block
+    int64_t offset;                         // Byte offset of the first row in the file
+    std::vector<CSVColumnStats> columns;    // Per column statistics, empty if zone maps were not built
+
+    // constructor initializes everything
+    CSVBlockInfo(int64_t first_row = 0, int64_t n_rows = 0, int64_t offset = 0) :
+                first_row(first_row), n_rows(n_rows), offset(offset)
+    {}
+};
+
+//! @brief Options for rendering a CSV file as a table.
+class CSVRenderOptions
+{
+public:
+    int64_t first_row;                      // First row to render (starting at 1), for pages
+    int64_t max_rows;                       // Maximum number of rows to render, 0 for all
+    bool tail;                              // Render the last max_rows rows instead
+    int64_t sample_rows;                    // Rows at the start of the output used to size the columns
+    int max_width;                          // Widest a column can be, longer values are cut with '~'
+    FILE* output;                           // Stream to write to, stdout if NULL
+
+    // constructor initializes everything
+    CSVRenderOptions(int64_t first_row = 1,
+                int64_t max_rows = 0,
+                bool tail = false,
+                int64_t sample_rows = 256,
+                int max_width = 40,
+                FILE* output = NULL) :
+                first_row(first_row), max_rows(max_rows), tail(tail),
+                sample_rows(sample_rows), max_width(max_width), output(output)
+    {}
+};
+
+//! @brief One structural problem found by CSV_Utility::Validate
+class CSVViolation
+{
+public:
+    int64_t row;                            // Row the problem is on (starting at 1)
+    uint64_t offset;                        // Byte offset of the problem in the file
+    int type;                               // VIOLATION_TYPE of the problem
+    int columns;                            // Columns found on the row, for column count violations
+
+    // constructor initializes everything
+    CSVViolation(int64_t row = 0, uint64_t offset = 0, int type = 0, int columns = 0) :
+                row(row), offset(offset), type(type), columns(columns)
+    {}
+};
+
+//! @brief Counters of the parsed row cache, see CSV_Utility::SetRowCache.
+class CSVRowCacheStats
+{
+public:
+    uint64_t hits;                          // Reads answered from the cache
+    uint64_t misses;                        // Reads that had to read and parse the row
+    uint64_t evictions;                     // Rows dropped to stay within the capacity
+    uint64_t invalidations;                 // Times the cache was emptied because the file changed
+    uint64_t rows;                          // Rows in the cache
+    size_t bytes;                           // Estimated bytes held by the cached rows
+    size_t capacity;                        // Most bytes the cache may hold, 0 if disabled
+
+    // constructor initializes everything
+    CSVRowCacheStats(uint64_t hits = 0, uint64_t misses = 0, uint64_t evictions = 0, uint64_t invalidations = 0,
+                uint64_t rows = 0, size_t bytes = 0, size_t capacity = 0) :
+                hits(hits), misses(misses), evictions(evictions), invalidations(invalidations),
+                rows(rows), bytes(bytes), capacity(capacity)
+    {}
+};
+
 //! @brief enum to hold the different combinations of modes for file use.
 enum UTILITY_MODE
 {
@@ -82,4 +180,88 @@ enum UTILITY_MODE
     WRITE_TRUNC = std::ios::out | std::ios::trunc,
 	READ_WRITE_APPEND = std::ios::in | std::ios::out | std::ios::app,
     READ_WRITE_TRUNC = std::ios::in | std::ios::out | std::ios::trunc,
+};
+
+//! @brief enum to hold the supported join types for CSV_Utility::Join
+enum JOIN_TYPE
+{
+    INNER_JOIN,                             // Rows with a key present in both files
+    LEFT_JOIN,                              // Every left row, right columns empty when unmatched
+    SEMI_JOIN,                              // Left rows with at least one match, left columns only
+};
+
+//! @brief enum to hold the durability policies for rows written by CSV_Utility
+enum DURABILITY_MODE
+{
+    DURABILITY_NONE,                        // Leave flushing to the file stream, no fsync
+    DURABILITY_ROWS,                        // fsync after every N rows
+    DURABILITY_INTERVAL,                    // fsync every T milliseconds from a background thread
+};
+
+//! @brief enum to hold the structural problems reported by CSV_Utility::Validate
+enum VIOLATION_TYPE
+{
+    VIOLATION_COLUMN_COUNT,                 // Row has a different number of columns than the first row
+    VIOLATION_UNBALANCED_QUOTE,             // Quoted field is not closed before the end of the row
+    VIOLATION_STRAY_CR,                     // Carriage return not followed by a newline
+    VIOLATION_INVALID_UTF8,                 // Byte sequence that is not valid UTF-8
+};
+
+//! @brief enum to hold the ways CSV_Utility::Split divides a file
+enum SPLIT_STRATEGY
+{
+    SPLIT_BY_BYTES,                         // N shards of about equal size, cut at row boundaries
+    SPLIT_BY_ROWS,                          // Shards of a fixed number of rows
+    SPLIT_BY_HASH,                          // K shards, rows placed by a hash of a key column
+};
+
+//! @brief enum to hold the normalization applied to rows as they are read, combine with |
+enum INGEST_OPTION
+{
+    INGEST_NONE = 0,                        // Rows are returned exactly as stored
+    INGEST_STRIP_BOM = 1,                   // Drop a UTF-8 byte order mark from the start of the file
+    INGEST_NORMALIZE_CRLF = 2,              // Drop the '\r' of CRLF line endings
+    INGEST_VALIDATE_UTF8 = 4,               // Fail reads of rows that are not valid UTF-8
+    INGEST_DEFAULT = INGEST_STRIP_BOM | INGEST_NORMALIZE_CRLF,
+};
+
+//! @brief enum to hold which written fields are quoted, quotes inside a quoted field are doubled (RFC 4180)
+enum QUOTE_POLICY
+{
+    QUOTE_MINIMAL,                          // Fields holding the delimiter, a quote, CR or LF
+    QUOTE_ALL,                              // Every field
+    QUOTE_NON_NUMERIC,                      // Fields that are not numbers, and numbers that need it
+    QUOTE_NONE,                             // Fields are written raw, a field needing quotes corrupts the row
+};
+
+//! @brief enum to hold the levels of log events, see CSV_Log
+enum CSV_LOG_LEVEL
+{
+    CSV_LOG_DEBUG,                          // Detail for tracing problems
+    CSV_LOG_INFO,                           // Normal operation, file opened, settings changed
+    CSV_LOG_WARNING,                        // Something unexpected that was handled
+    CSV_LOG_ERROR,                          // An operation failed
+    CSV_LOG_OFF,                            // Level filter that disables every event
+};
+
+//! @brief enum to hold the event codes of log events, see CSV_Log
+enum CSV_EVENT
+{
+    EVENT_DELIMITER_CHANGED,                // value: the new delimiter
+    EVENT_FILE_OPENED,                      // subject: the file
+    EVENT_FILE_OPEN_FAILED,                 // subject: the file
+    EVENT_INVALID_PATH,                     // subject: the file
+    EVENT_DIRECTORY_FAILED,                 // subject: the directory, value: errno
+    EVENT_EXTENSION_ADDED,                  // subject: the file, with the extension added
+    EVENT_INVALID_COLUMN,                   // value: the column
+    EVENT_INVALID_ARGUMENT,                 // value: the argument
+    EVENT_STREAM_FAILED,                    // subject: the file, value: the stream state bits
+    EVENT_MEMORY_BUDGET_EXCEEDED,           // subject: the file, value: the budget in bytes
+    EVENT_SPILLED_TO_DISK,                  // subject: the spill file, value: the budget in bytes
+    EVENT_OUTPUT_IS_INPUT,                  // subject: the output
+    EVENT_COLUMNS_MISMATCH,                 // subject: the file that doesn't match
+    EVENT_SYNC_FAILED,                      // subject: the file
+    EVENT_INVALID_UTF8,                     // subject: the file
+    EVENT_UNKNOWN_COLUMN,                   // subject: the file
+    EVENT_PARTITION_OVER_BUDGET,            // subject: the partition file, value: the budget in bytes
 };
\ No newline at end of file
@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_KeySet.cpp
+//!
+//! @brief		Implementation for the CSV_KeySet class
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <algorithm>					// fill
+//
+#include "CSV_KeySet.h"					// Key set class header
+///////////////////////////////////////////////////////////////////////////////
+
+CSV_KeySet::CSV_KeySet(const size_t capacity)
+{
+	size_t slots = 16;
+	while (slots < capacity)
+	{
+		slots <<= 1;
+	}
+	mFingerprints.assign(slots, 0);
+	mEntries.assign(slots, 0);
+	mMask = slots - 1;
+	mCollisions = 0;
+}
+
+bool CSV_KeySet::Insert(std::string_view key, const uint64_t hash, const int64_t row)
+{
+	uint64_t fingerprint = Fingerprint(hash);
+	bool found = false;
+	size_t slot = Probe(key, fingerprint, found);
+	if (found)
+	{
+		return false;
+	}
+
+	// Keep the load at most half so probe runs stay short.
+	if ((mRows.size() + 1) * 2 > mFingerprints.size())
+	{
+		Grow();
+		slot = Probe(key, fingerprint, found);
+	}
+
+	mFingerprints[slot] = fingerprint;
+	mEntries[slot] = (uint32_t)mRows.size();
+	mKeys.append(key.data(), key.size());
+	mKeyEnds.push_back(mKeys.size());
+	mRows.push_back(row);
+	return true;
+}
+
+void CSV_KeySet::Assign(std::string_view key, const uint64_t hash, const int64_t row)
+{
+	bool found = false;
+	size_t slot = Probe(key, Fingerprint(hash), found);
+	if (found)
+	{
+		mRows[mEntries[slot]] = row;
+		return;
+	}
+	Insert(key, hash, row);
+}
+
+int64_t CSV_KeySet::Find(std::string_view key, const uint64_t hash) const
+{
+	bool found = false;
+	size_t slot = Probe(key, Fingerprint(hash), found);
+	return found ? mRows[mEntries[slot]] : -1;
+}
+
+void CSV_KeySet::Clear()
+{
+	std::fill(mFingerprints.begin(), mFingerprints.end(), 0);
+	mKeyEnds.clear();
+	mRows.clear();
+	mKeys.clear();
+	mCollisions = 0;
+}
+
+size_t CSV_KeySet::Size() const
+{
+	return mRows.size();
+}
+
+size_t CSV_KeySet::Memory() const
+{
+	return mFingerprints.capacity() * sizeof(uint64_t) + mEntries.capacity() * sizeof(uint32_t) +
+		mKeyEnds.capacity() * sizeof(uint64_t) + mRows.capacity() * sizeof(int64_t) + mKeys.capacity();
+}
+
+uint64_t CSV_KeySet::Collisions() const
+{
+	return mCollisions;
+}
+
+size_t CSV_KeySet::Probe(std::string_view key, const uint64_t fingerprint, bool& found) const
+{
+	size_t slot = (size_t)fingerprint & mMask;
+	while (mFingerprints[slot] != 0)
+	{
+		// Only a matching fingerprint needs the key bytes, which verify it isn't a collision.
+		if (mFingerprints[slot] == fingerprint)
+		{
+			uint32_t entry = mEntries[slot];
+			uint64_t start = entry > 0 ? mKeyEnds[entry - 1] : 0;
+			if (std::string_view(mKeys.data() + start, (size_t)(mKeyEnds[entry] - start)) == key)
+			{
+				found = true;
+				return slot;
+			}
+			mCollisions++;
+		}
+		slot = (slot + 1) & mMask;
+	}
+
+	found = false;
+	return slot;
+}
+
+uint64_t CSV_KeySet::Fingerprint(const uint64_t hash)
+{
+	// Mix the hash so the slot bits are well spread whatever hash was used, ex. keys of one partition.
+	uint64_t mixed = hash;
+	mixed ^= mixed >> 33;
+	mixed *= 0xFF51AFD7ED558CCDULL;
+	mixed ^= mixed >> 33;
+	mixed *= 0xC4CEB9FE1A85EC53ULL;
+	mixed ^= mixed >> 33;
+	return mixed != 0 ? mixed : 1;
+}
+
+void CSV_KeySet::Grow()
+{
+	std::vector<uint64_t> fingerprints(mFingerprints.size() * 2, 0);
+	std::vector<uint32_t> entries(mEntries.size() * 2, 0);
+	size_t mask = fingerprints.size() - 1;
+
+	// The fingerprints are the mixed hashes, so entries move without rehashing their keys.
+	for (size_t i = 0; i < mFingerprints.size(); i++)
+	{
+		if (mFingerprints[i] == 0)
+		{
+			continue;
+		}
+		size_t slot = (size_t)mFingerprints[i] & mask;
+		while (fingerprints[slot] != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		fingerprints[slot] = mFingerprints[i];
+		entries[slot] = mEntries[i];
+	}
+
+	mFingerprints.swap(fingerprints);
+	mEntries.swap(entries);
+	mMask = mask;
+}
@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_KeySet.h
+//!
+//! @brief		A compact open addressing set of row keys.
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstdint>						// Fingerprints and rows
+#include <string>                       // Key storage
+#include <string_view>					// Views of keys
+#include <vector>                       // Vectors
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CSV_KEY_SET_CAPACITY		// Default number of slots, a power of two, doubled when over half full.
+#define     CSV_KEY_SET_CAPACITY		1024
+#endif
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! @brief Set of keys, each with the row it was last stored with.
+//! @note Slots hold a 64 bit fingerprint and an entry number, probed linearly. The key bytes are
+//!		  packed one after another in a single buffer and only compared when fingerprints match,
+//!		  so a fingerprint collision never merges two different keys.
+class CSV_KeySet
+{
+public:
+	//! @brief Overloaded Constructor
+	//! @param capacity - [in] - initial number of slots, rounded up to a power of two.
+	CSV_KeySet(const size_t capacity = CSV_KEY_SET_CAPACITY);
+
+	//! @brief Add a key if it isn't in the set.
+	//! @param key - [in] - the key.
+	//! @param hash - [in] - 64 bit hash of the key, mixed again before use.
+	//! @param row - [in] - the row stored with a new key.
+	//! @return bool: true if the key was added, false if it was already in the set.
+	bool Insert(std::string_view key, const uint64_t hash, const int64_t row);
+
+	//! @brief Add a key or replace the row stored with it.
+	//! @param key - [in] - the key.
+	//! @param hash - [in] - 64 bit hash of the key, mixed again before use.
+	//! @param row - [in] - the row to store.
+	void Assign(std::string_view key, const uint64_t hash, const int64_t row);
+
+	//! @brief Get the row stored with a key.
+	//! @param key - [in] - the key.
+	//! @param hash - [in] - 64 bit hash of the key, mixed again before use.
+	//! @return int64_t: the row, -1 if the key isn't in the set.
+	int64_t Find(std::string_view key, const uint64_t hash) const;
+
+	//! @brief Remove every key, keeping the allocated memory.
+	void Clear();
+
+	//! @brief Get the number of keys in the set.
+	//! @return size_t: the number of keys.
+	size_t Size() const;
+
+	//! @brief Get the bytes allocated by the set.
+	//! @return size_t: the bytes used by slots, entries and key storage.
+	size_t Memory() const;
+
+	//! @brief Get the number of fingerprint matches whose keys differed.
+	//! @return uint64_t: the number of collisions found.
+	uint64_t Collisions() const;
+
+private:
+	//! @brief Find the slot of a key, or the empty slot it would go in.
+	//! @param key - [in] - the key.
+	//! @param fingerprint - [in] - the key's fingerprint, never 0.
+	//! @param found - [out] - true if the key is in the slot, false if the slot is empty.
+	//! @return size_t: the slot.
+	size_t Probe(std::string_view key, const uint64_t fingerprint, bool& found) const;
+
+	//! @brief Get the fingerprint of a hash.
+	//! @param hash - [in] - 64 bit hash of the key.
+	//! @return uint64_t: the mixed hash, never 0 since 0 marks an empty slot.
+	static uint64_t Fingerprint(const uint64_t hash);
+
+	//! @brief Double the slots and reinsert the fingerprints, the keys aren't touched.
+	void Grow();
+
+	std::vector<uint64_t>	mFingerprints;		//!< Fingerprint of each slot, 0 if empty
+	std::vector<uint32_t>	mEntries;			//!< Entry of each slot
+	std::vector<uint64_t>	mKeyEnds;			//!< End of each entry's key in mKeys
+	std::vector<int64_t>	mRows;				//!< Row of each entry
+	std::string				mKeys;				//!< Key bytes of every entry
+	size_t					mMask;				//!< Number of slots minus one
+	mutable uint64_t		mCollisions;		//!< Fingerprint matches with different keys
+};
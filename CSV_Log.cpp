@@ -0,0 +1,333 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_Log.cpp
+//!
+//! @brief		Implementation for the CSV_Log classes
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <chrono>						// Event times
+#include <ios>							// Stream state bits
+#include <system_error>					// errno text
+#include <thread>						// Yielding on a full queue
+//
+#include "CSV_Log.h"					// Log class header
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef CPP_LOGGER
+//! @brief Sink forwarding events to CPP_Logger.
+class CSV_CppLoggerSink : public CSV_LogSink
+{
+public:
+	void Write(const CSVLogEvent* events, const size_t count) override
+	{
+		Log* log = log->GetInstance();
+		for (size_t i = 0; i < count; i++)
+		{
+			LOG_LEVEL level = events[i].level >= CSV_LOG_LEVEL::CSV_LOG_WARNING ? LOG_LEVEL::LOG_ERROR : LOG_LEVEL::LOG_INFO;
+			log->AddEntry(level, events[i].user, "%s", CSV_Log::Format(events[i]).c_str());
+		}
+	}
+};
+#endif
+
+CSVLogEvent::CSVLogEvent(int level, int event, std::string user, const char* operation, std::string subject, int64_t value) :
+	level(level), event(event), user(user), operation(operation), subject(subject), value(value)
+{
+	time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+CSV_TextLogSink::CSV_TextLogSink(FILE* stream, const bool buffered)
+{
+	mStream = stream != NULL ? stream : stdout;
+	mBuffered = buffered;
+}
+
+void CSV_TextLogSink::Write(const CSVLogEvent* events, const size_t count)
+{
+	std::string text;
+	for (size_t i = 0; i < count; i++)
+	{
+		text += CSV_Log::Format(events[i]);
+		text.push_back('\n');
+	}
+	fwrite(text.data(), 1, text.size(), mStream);
+	fflush(mStream);
+}
+
+bool CSV_TextLogSink::Buffered() const
+{
+	return mBuffered;
+}
+
+CSV_Log& CSV_Log::GetInstance()
+{
+	static CSV_Log instance;
+	return instance;
+}
+
+CSV_Log::CSV_Log() : mSlots(new Slot[CSV_LOG_QUEUE_SIZE])
+{
+	static_assert((CSV_LOG_QUEUE_SIZE & (CSV_LOG_QUEUE_SIZE - 1)) == 0, "CSV_LOG_QUEUE_SIZE must be a power of two");
+
+	for (size_t i = 0; i < CSV_LOG_QUEUE_SIZE; i++)
+	{
+		mSlots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	mHead.store(0);
+	mTail.store(0);
+	mDraining.clear();
+	mDropped.store(0);
+	mLevel.store(CSV_LOG_LEVEL::CSV_LOG_INFO);
+#ifdef CPP_LOGGER
+	mSink = std::make_shared<CSV_CppLoggerSink>();
+#else
+	mSink = std::make_shared<CSV_TextLogSink>(stdout);
+#endif
+	mBuffered.store(mSink->Buffered());
+}
+
+CSV_Log::~CSV_Log()
+{
+	Flush();
+}
+
+void CSV_Log::SetLevel(const CSV_LOG_LEVEL level)
+{
+	mLevel.store(level, std::memory_order_relaxed);
+}
+
+void CSV_Log::SetSink(std::shared_ptr<CSV_LogSink> sink)
+{
+	// Events queued for the old sink go to it first.
+	Flush();
+	mBuffered.store(sink ? sink->Buffered() : true, std::memory_order_relaxed);
+	std::atomic_store(&mSink, sink);
+}
+
+void CSV_Log::Emit(CSVLogEvent&& event)
+{
+	bool urgent = event.level >= CSV_LOG_LEVEL::CSV_LOG_ERROR || !mBuffered.load(std::memory_order_relaxed);
+
+	// Make room on a full queue, giving a drain on another thread time to finish before dropping the event.
+	for (size_t attempt = 0; !Enqueue(event); attempt++)
+	{
+		if (attempt == CSV_LOG_QUEUE_SIZE)
+		{
+			mDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		Drain();
+		std::this_thread::yield();
+	}
+
+	if (urgent || mHead.load(std::memory_order_relaxed) - mTail.load(std::memory_order_relaxed) >= CSV_LOG_BATCH_SIZE)
+	{
+		Drain();
+	}
+}
+
+void CSV_Log::Flush()
+{
+	// Every event queued before now has to reach the sink. Another thread may hold the drain or take
+	// it between tries, so keep draining until the queue is past the events seen on entry.
+	size_t target = mHead.load(std::memory_order_acquire);
+	while (true)
+	{
+		if (!mDraining.test_and_set(std::memory_order_acquire))
+		{
+			WriteQueued();
+			mDraining.clear(std::memory_order_release);
+			if (mTail.load(std::memory_order_acquire) >= target)
+			{
+				return;
+			}
+		}
+		std::this_thread::yield();
+	}
+}
+
+uint64_t CSV_Log::Dropped() const
+{
+	return mDropped.load(std::memory_order_relaxed);
+}
+
+std::string CSV_Log::Format(const CSVLogEvent& event)
+{
+	std::string text = event.user + " - ";
+	if (event.operation != nullptr && event.operation[0] != '\0')
+	{
+		text += event.operation;
+		text += " - ";
+	}
+
+	switch (event.event)
+	{
+	case CSV_EVENT::EVENT_DELIMITER_CHANGED:
+		text += "Received new delimiter: ";
+		text.push_back((char)event.value);
+		break;
+	case CSV_EVENT::EVENT_FILE_OPENED:
+		text += "File open successful: " + event.subject;
+		break;
+	case CSV_EVENT::EVENT_FILE_OPEN_FAILED:
+		text += "Failed to open the file: " + event.subject;
+		break;
+	case CSV_EVENT::EVENT_INVALID_PATH:
+		text += "Not a valid path: " + event.subject;
+		break;
+	case CSV_EVENT::EVENT_DIRECTORY_FAILED:
+		// The generic category gives the errno text on every platform, strerror_s is MSVC only.
+		text += "Failed to make directory " + event.subject + ": " + std::generic_category().message((int)event.value);
+		break;
+	case CSV_EVENT::EVENT_EXTENSION_ADDED:
+		text += "Filename has no extension, added the default extension: " + event.subject;
+		break;
+	case CSV_EVENT::EVENT_INVALID_COLUMN:
+		text += "Column input must be more than 0, got " + std::to_string(event.value);
+		break;
+	case CSV_EVENT::EVENT_INVALID_ARGUMENT:
+		text += "Invalid argument: " + std::to_string(event.value);
+		break;
+	case CSV_EVENT::EVENT_STREAM_FAILED:
+		if (event.value & std::ios::eofbit)
+		{
+			text += "Eof bit set";
+		}
+		else if (event.value & std::ios::badbit)
+		{
+			text += "Bad bit set";
+		}
+		else if (event.value & std::ios::failbit)
+		{
+			text += "Fail bit set";
+		}
+		else
+		{
+			text += "Unknown failure";
+		}
+		text += event.subject.empty() ? "" : ": " + event.subject;
+		break;
+	case CSV_EVENT::EVENT_MEMORY_BUDGET_EXCEEDED:
+		text += event.subject + " passed the memory budget of " + std::to_string(event.value) + " bytes, parse into a CSV_RowStore instead";
+		break;
+	case CSV_EVENT::EVENT_SPILLED_TO_DISK:
+		text += "Passed the memory budget of " + std::to_string(event.value) + " bytes, spilling rows to " + event.subject;
+		break;
+	case CSV_EVENT::EVENT_OUTPUT_IS_INPUT:
+		text += "Output can not be one of the inputs: " + event.subject;
+		break;
+	case CSV_EVENT::EVENT_COLUMNS_MISMATCH:
+		text += "Columns don't match the first input: " + event.subject;
+		break;
+	case CSV_EVENT::EVENT_SYNC_FAILED:
+		text += "Failed to sync " + event.subject;
+		break;
+	case CSV_EVENT::EVENT_INVALID_UTF8:
+		text += "Read a row that is not valid UTF-8, see Validate for its location: " + event.subject;
+		break;
+	case CSV_EVENT::EVENT_UNKNOWN_COLUMN:
+		text += "A step uses a column that " + event.subject + " does not have";
+		break;
+	case CSV_EVENT::EVENT_PARTITION_OVER_BUDGET:
+		text += "Partition " + event.subject + " can not be split below the memory budget of " + std::to_string(event.value) + " bytes, joining it in memory";
+		break;
+	default:
+		text += "Event " + std::to_string(event.event) + " " + event.subject + " " + std::to_string(event.value);
+		break;
+	}
+	return text;
+}
+
+bool CSV_Log::Enqueue(CSVLogEvent& event)
+{
+	// Bounded multi producer queue: a slot is free for position p when its sequence is p.
+	size_t position = mHead.load(std::memory_order_relaxed);
+	while (true)
+	{
+		Slot& slot = mSlots[position & (CSV_LOG_QUEUE_SIZE - 1)];
+		size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+		if (difference == 0)
+		{
+			if (mHead.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				slot.event = std::move(event);
+				slot.sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			return false;
+		}
+		else
+		{
+			position = mHead.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool CSV_Log::Dequeue(CSVLogEvent& event)
+{
+	// A slot holds the event for position p when its sequence is p + 1.
+	size_t position = mTail.load(std::memory_order_relaxed);
+	while (true)
+	{
+		Slot& slot = mSlots[position & (CSV_LOG_QUEUE_SIZE - 1)];
+		size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+		if (difference == 0)
+		{
+			if (mTail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				event = std::move(slot.event);
+				slot.sequence.store(position + CSV_LOG_QUEUE_SIZE, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			return false;
+		}
+		else
+		{
+			position = mTail.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+void CSV_Log::Drain()
+{
+	if (mDraining.test_and_set(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	WriteQueued();
+	mDraining.clear(std::memory_order_release);
+}
+
+void CSV_Log::WriteQueued()
+{
+	std::vector<CSVLogEvent> batch;
+	CSVLogEvent event;
+	while (Dequeue(event))
+	{
+		batch.push_back(std::move(event));
+	}
+
+	std::shared_ptr<CSV_LogSink> sink = std::atomic_load(&mSink);
+	if (sink && !batch.empty())
+	{
+		sink->Write(batch.data(), batch.size());
+	}
+}
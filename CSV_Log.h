@@ -0,0 +1,199 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_Log.h
+//!
+//! @brief		Structured, buffered logging for the CSV Utility with pluggable sinks.
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <atomic>						// Lock free queue
+#include <cstdint>						// Fixed width values
+#include <cstdio>						// Text sink output
+#include <memory>						// Shared sinks
+#include <string>                       // Strings
+#include <vector>                       // Vectors
+//
+#include "CSV_Info.h"					// Log levels and event codes
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CSV_LOG_COMPILE_LEVEL		// Events below this CSV_LOG_LEVEL are compiled out.
+#define     CSV_LOG_COMPILE_LEVEL		0
+#endif
+#ifndef     CSV_LOG_QUEUE_SIZE			// Number of events the queue holds, a power of two.
+#define     CSV_LOG_QUEUE_SIZE			1024
+#endif
+#ifndef     CSV_LOG_BATCH_SIZE			// Queued events that trigger a write to the sink.
+#define     CSV_LOG_BATCH_SIZE			64
+#endif
+//
+//! @brief Log an event. Nothing is built or evaluated for levels below CSV_LOG_COMPILE_LEVEL or below the runtime level.
+//! @note ex. CSV_LOG(CSV_LOG_ERROR, EVENT_INVALID_COLUMN, mUser, "ReadColumn", "", column);
+#define CSV_LOG(level, event, user, operation, subject, value)										\
+	do																								\
+	{																								\
+		if ((level) >= CSV_LOG_COMPILE_LEVEL && CSV_Log::GetInstance().Enabled(level))				\
+		{																							\
+			CSV_Log::GetInstance().Emit(CSVLogEvent((level), (event), (user), (operation), (subject), (int64_t)(value)));	\
+		}																							\
+	} while (0)
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! @brief One log event, a code with a few fixed fields instead of a formatted message.
+class CSVLogEvent
+{
+public:
+	int64_t time;							// Microseconds since the epoch
+	int level;								// CSV_LOG_LEVEL of the event
+	int event;								// CSV_EVENT code
+	std::string user;						// Name of the utility that logged it
+	const char* operation;					// Operation that logged it, a string literal
+	std::string subject;					// File or name the event is about, see CSV_EVENT
+	int64_t value;							// Number the event is about, see CSV_EVENT
+
+	// constructor initializes everything
+	CSVLogEvent(int level = CSV_LOG_INFO,
+				int event = 0,
+				std::string user = "",
+				const char* operation = "",
+				std::string subject = "",
+				int64_t value = 0);
+};
+
+//! @brief Destination for log events, derive to send events anywhere.
+//! @note Write is only ever called by one thread at a time.
+class CSV_LogSink
+{
+public:
+	virtual ~CSV_LogSink() = default;
+
+	//! @brief Write a batch of events.
+	//! @param events - [in] - the events, oldest first.
+	//! @param count - [in] - the number of events.
+	virtual void Write(const CSVLogEvent* events, const size_t count) = 0;
+
+	//! @brief Check if events below the error level may wait for a batch.
+	//! @return bool: true to get events in batches of CSV_LOG_BATCH_SIZE, false to get each one as it is logged.
+	virtual bool Buffered() const
+	{
+		return true;
+	}
+};
+
+//! @brief Sink writing each event as a line of text, one flush per write.
+//! @note Unbuffered by default so a console shows events as they happen.
+class CSV_TextLogSink : public CSV_LogSink
+{
+public:
+	//! @brief Overloaded Constructor
+	//! @param stream - [in] - the stream to write to.
+	//! @param buffered - [in] - true to write events in batches, ex. to a log file, false to write each one.
+	CSV_TextLogSink(FILE* stream = stdout, const bool buffered = false);
+
+	//! @brief Write a batch of events.
+	//! @param events - [in] - the events, oldest first.
+	//! @param count - [in] - the number of events.
+	void Write(const CSVLogEvent* events, const size_t count) override;
+
+	//! @brief Check if events below the error level may wait for a batch.
+	//! @return bool: the buffered option given to the constructor.
+	bool Buffered() const override;
+
+private:
+	FILE*	mStream;						//!< Stream to write to
+	bool	mBuffered;						//!< True to write events in batches
+};
+
+//! @brief The logger shared by every CSV_Utility. Events are queued without locks and 
+//!		   handed to a buffered sink in batches, errors and events for an unbuffered sink
+//!		   are handed over straight away.
+class CSV_Log
+{
+public:
+	//! @brief Get the logger.
+	//! @return CSV_Log&: the logger.
+	static CSV_Log& GetInstance();
+
+	//! @brief Default Deconstructor, writes any queued events.
+	~CSV_Log();
+
+	//! @brief Check if events of a level are logged.
+	//! @param level - [in] - the CSV_LOG_LEVEL to check.
+	//! @return bool: true if logged, else false.
+	bool Enabled(const int level) const
+	{
+		return level >= mLevel.load(std::memory_order_relaxed);
+	}
+
+	//! @brief Set the lowest level logged, CSV_LOG_OFF to log nothing.
+	//! @param level - [in] - the CSV_LOG_LEVEL.
+	void SetLevel(const CSV_LOG_LEVEL level);
+
+	//! @brief Set the sink events are written to.
+	//! @param sink - [in] - the sink, nullptr to discard events.
+	void SetSink(std::shared_ptr<CSV_LogSink> sink);
+
+	//! @brief Queue an event, use CSV_LOG instead so disabled levels cost nothing.
+	//! @param event - [in] - the event.
+	void Emit(CSVLogEvent&& event);
+
+	//! @brief Write every queued event to the sink, waiting out a drain on another thread.
+	void Flush();
+
+	//! @brief Get the number of events dropped because the queue was full.
+	//! @return uint64_t: the number of events dropped.
+	uint64_t Dropped() const;
+
+	//! @brief Format an event as a line of text, without a newline.
+	//! @param event - [in] - the event.
+	//! @return std::string: the text.
+	static std::string Format(const CSVLogEvent& event);
+
+protected:
+private:
+	//! @brief Default Constructor
+	CSV_Log();
+
+	//! @brief One slot of the queue.
+	struct Slot
+	{
+		std::atomic<size_t>		sequence;		//!< Turn of the slot, see Enqueue / Dequeue
+		CSVLogEvent				event;			//!< The event held
+	};
+
+	//! @brief Add an event to the queue.
+	//! @param event - [in] - the event, moved from on success.
+	//! @return bool: true if queued, false if the queue is full.
+	bool Enqueue(CSVLogEvent& event);
+
+	//! @brief Take the oldest event from the queue.
+	//! @param event - [out] - the event.
+	//! @return bool: true if an event was taken, false if the queue is empty.
+	bool Dequeue(CSVLogEvent& event);
+
+	//! @brief Hand the queued events to the sink, unless another thread already is.
+	void Drain();
+
+	//! @brief Hand the queued events to the sink, the caller holds mDraining.
+	void WriteQueued();
+
+	std::atomic<int>			mLevel;			//!< Lowest level logged
+	std::shared_ptr<CSV_LogSink>	mSink;		//!< Sink, read and replaced atomically
+	std::atomic<bool>			mBuffered;		//!< Copy of the sink's Buffered, read on every event
+	std::unique_ptr<Slot[]>		mSlots;			//!< Queue storage
+	std::atomic<size_t>			mHead;			//!< Next position to enqueue
+	std::atomic<size_t>			mTail;			//!< Next position to dequeue
+	std::atomic_flag			mDraining;		//!< Held by the thread handing events to the sink
+	std::atomic<uint64_t>		mDropped;		//!< Events dropped on a full queue
+};
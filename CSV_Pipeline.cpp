@@ -0,0 +1,342 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_Pipeline.cpp
+//!
+//! @brief		Implementation for the CSV_Pipeline class
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <filesystem>					// Checking the sink isn't the source
+#include <fstream>						// Sink file
+#include <thread>						// Hardware thread count
+//
+#include "CSV_Pipeline.h"				// Pipeline class header
+#include "CSV_BatchWorkers.h"			// Parallel batches
+#include "CSV_Log.h"					// Logging
+///////////////////////////////////////////////////////////////////////////////
+
+CSV_Pipeline::CSV_Pipeline(const std::string source, const char delimiter, const size_t bufferSize, const int depth,
+						   const int ingest, const int quote, const std::string user)
+{
+	mSource = source;
+	mDelimiter = delimiter;
+	mBufferSize = bufferSize;
+	mDepth = depth;
+	mIngest = ingest;
+	mQuote = quote;
+	mUser = user;
+	mTransforms = 0;
+}
+
+CSV_Pipeline& CSV_Pipeline::Filter(RowFilter filter)
+{
+	Step step;
+	step.type = STEP_FILTER;
+	step.filter = filter;
+	mSteps.push_back(step);
+	return *this;
+}
+
+CSV_Pipeline& CSV_Pipeline::Where(const int column, FieldFilter filter)
+{
+	Step step;
+	step.type = STEP_WHERE;
+	step.column = column;
+	step.fieldFilter = filter;
+	mSteps.push_back(step);
+	return *this;
+}
+
+CSV_Pipeline& CSV_Pipeline::Select(const std::vector<int>& columns)
+{
+	Step step;
+	step.type = STEP_SELECT;
+	step.columns = columns;
+	mSteps.push_back(step);
+	return *this;
+}
+
+CSV_Pipeline& CSV_Pipeline::Rename(const int column, const std::string name)
+{
+	Step step;
+	step.type = STEP_RENAME;
+	step.column = column;
+	step.name = name;
+	mSteps.push_back(step);
+	return *this;
+}
+
+CSV_Pipeline& CSV_Pipeline::Transform(const int column, FieldTransform transform)
+{
+	Step step;
+	step.type = STEP_TRANSFORM;
+	step.column = column;
+	step.transform = transform;
+	mSteps.push_back(step);
+	mTransforms++;
+	return *this;
+}
+
+int64_t CSV_Pipeline::Run(const std::string output, const int threads)
+{
+	// Opening the sink would truncate the source before it is read.
+	std::error_code ec;
+	if (std::filesystem::equivalent(mSource, output, ec))
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_OUTPUT_IS_INPUT, mUser, "Pipeline", output, 0);
+		return -1;
+	}
+
+	CSV_ReadAhead file(mBufferSize, mDepth, mIngest, mDelimiter);
+	if (!file.Open(mSource))
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_FILE_OPEN_FAILED, mUser, "Pipeline", mSource, 0);
+		return -1;
+	}
+
+	// An empty source has no header to read.
+	std::string_view line;
+	if (!file.GetLine(line))
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_STREAM_FAILED, mUser, "Pipeline", mSource, std::ios::eofbit);
+		return -1;
+	}
+
+	// The header only goes through Select and Rename, which also checks every step's columns.
+	std::string header;
+	if (!ProcessHeader(line, header))
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_UNKNOWN_COLUMN, mUser, "Pipeline", mSource, 0);
+		return -1;
+	}
+
+	std::ofstream sink(output, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!sink.is_open())
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_FILE_OPEN_FAILED, mUser, "Pipeline", output, 0);
+		return -1;
+	}
+	sink << header << '\n';
+
+	size_t count = threads > 0 ? (size_t)threads : (size_t)std::thread::hardware_concurrency();
+	count = count > 0 ? count : 1;
+
+	// Rows are read in batches, each thread runs one batch through the steps and
+	// the results are written in batch order so the sink keeps the source order.
+	struct Batch
+	{
+		std::string				text;			//!< Rows of the batch, back to back
+		std::vector<size_t>		ends;			//!< End of each row in text, rows may hold newlines
+		std::string				out;			//!< Finished rows
+		int64_t					rows = 0;		//!< Rows kept
+	};
+	int64_t written = 0;
+
+	auto process = [this](Batch& batch)
+	{
+		Fields fields, selected;
+		std::vector<std::string> scratch;
+		std::string unescaped;
+		batch.out.clear();
+		batch.rows = 0;
+		size_t start = 0;
+		for (size_t end : batch.ends)
+		{
+			if (ProcessRow(std::string_view(batch.text).substr(start, end - start), fields, selected, scratch, unescaped, batch.out))
+			{
+				batch.rows++;
+			}
+			start = end;
+		}
+	};
+
+	auto fill = [&file, &line](Batch& batch)
+	{
+		batch.text.clear();
+		batch.ends.clear();
+		while (batch.text.size() < CSV_PIPELINE_BATCH_SIZE && file.GetLine(line))
+		{
+			batch.text.append(line.data(), line.size());
+			batch.ends.push_back(batch.text.size());
+		}
+		return !batch.ends.empty();
+	};
+
+	auto drain = [&sink, &written](Batch& batch)
+	{
+		sink.write(batch.out.data(), (std::streamsize)batch.out.size());
+		written += batch.rows;
+	};
+
+	if (count == 1)
+	{
+		Batch batch;
+		while (fill(batch))
+		{
+			process(batch);
+			drain(batch);
+		}
+	}
+	else
+	{
+		// The workers start once, two batches each keep them busy while this thread reads and writes.
+		std::vector<Batch> batches(count * 2);
+		CSV_BatchWorkers workers(count, batches.size(), [&batches, &process](const size_t slot) { process(batches[slot]); });
+		size_t slot = 0;
+		bool more = true;
+		while (more)
+		{
+			while (workers.Take(slot, workers.Full()))
+			{
+				drain(batches[slot]);
+			}
+			more = fill(batches[workers.Free()]);
+			if (more)
+			{
+				workers.Submit();
+			}
+		}
+		while (workers.Take(slot, true))
+		{
+			drain(batches[slot]);
+		}
+	}
+
+	file.Close();
+	sink.flush();
+	return sink.good() ? written : -1;
+}
+
+bool CSV_Pipeline::ProcessRow(std::string_view line, Fields& fields, Fields& selected, std::vector<std::string>& scratch, 
+							  std::string& unescaped, std::string& out)
+{
+	CutFields(line, fields, unescaped);
+
+	// Transformed values live in scratch, sized up front so the views into it stay valid.
+	scratch.resize(mTransforms);
+	size_t transform = 0;
+	static const std::string_view empty;
+
+	for (const Step& step : mSteps)
+	{
+		switch (step.type)
+		{
+		case STEP_FILTER:
+			if (!step.filter(fields))
+			{
+				return false;
+			}
+			break;
+		case STEP_WHERE:
+			if (!step.fieldFilter(step.column <= (int)fields.size() ? fields[step.column - 1] : empty))
+			{
+				return false;
+			}
+			break;
+		case STEP_SELECT:
+			selected.clear();
+			for (int column : step.columns)
+			{
+				selected.push_back(column <= (int)fields.size() ? fields[column - 1] : empty);
+			}
+			fields.swap(selected);
+			break;
+		case STEP_TRANSFORM:
+			if (step.column > (int)fields.size())
+			{
+				fields.resize(step.column, empty);
+			}
+			scratch[transform] = step.transform(fields[step.column - 1]);
+			fields[step.column - 1] = scratch[transform];
+			transform++;
+			break;
+		case STEP_RENAME:
+			break;
+		}
+	}
+
+	// Join the fields onto the output, quoted as the utility's writers would.
+	for (size_t i = 0; i < fields.size(); i++)
+	{
+		if (i > 0)
+		{
+			out.push_back(mDelimiter);
+		}
+		size_t start = out.size();
+		out.append(fields[i].data(), fields[i].size());
+		CSV_QuoteField(out, start, mDelimiter, mQuote);
+	}
+	out.push_back('\n');
+	return true;
+}
+
+bool CSV_Pipeline::ProcessHeader(std::string_view line, std::string& out)
+{
+	Fields fields;
+	std::string unescaped;
+	CutFields(line, fields, unescaped);
+
+	std::vector<std::string> names;
+	for (std::string_view field : fields)
+	{
+		names.emplace_back(field);
+	}
+
+	for (const Step& step : mSteps)
+	{
+		if (step.type == STEP_SELECT)
+		{
+			std::vector<std::string> kept;
+			for (int column : step.columns)
+			{
+				if (column < 1 || column > (int)names.size())
+				{
+					return false;
+				}
+				kept.push_back(names[column - 1]);
+			}
+			names.swap(kept);
+		}
+		else if (step.type != STEP_FILTER && (step.column < 1 || step.column > (int)names.size()))
+		{
+			return false;
+		}
+		else if (step.type == STEP_RENAME)
+		{
+			names[step.column - 1] = step.name;
+		}
+	}
+
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (i > 0)
+		{
+			out.push_back(mDelimiter);
+		}
+		size_t start = out.size();
+		out += names[i];
+		CSV_QuoteField(out, start, mDelimiter, mQuote);
+	}
+	return true;
+}
+
+void CSV_Pipeline::CutFields(std::string_view line, Fields& fields, std::string& unescaped)
+{
+	// Reserved to the row's size, unescaping never outgrows it so the views stay valid.
+	fields.clear();
+	unescaped.clear();
+	unescaped.reserve(line.size());
+	size_t position = 0;
+	while (position <= line.size())
+	{
+		fields.push_back(CSV_NextField(line, position, mDelimiter, unescaped));
+	}
+}
@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_Pipeline.h
+//!
+//! @brief		A lazy pipeline of row filters, projections and transforms run in one streaming pass.
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <functional>					// Filters and transforms
+#include <string>                       // Strings
+#include <string_view>					// Views of fields
+#include <vector>                       // Vectors
+//
+#include "CSV_Info.h"					// Ingest options
+#include "CSV_ReadAhead.h"				// Read ahead line reader
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CSV_PIPELINE_BATCH_SIZE		// Bytes of rows handed to each thread at a time.
+#define     CSV_PIPELINE_BATCH_SIZE		(1024 * 1024)
+#endif
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! @brief A chain of steps from a source CSV file to a sink CSV file, built with CSV_Utility::Pipeline.
+//! @note Steps are only recorded while building. Run streams the source once, passing each row through
+//!		  every step in the order they were added, and writes the result with no intermediate tables.
+//!		  Columns (starting at 1) refer to the row as it is at that step, after any earlier Select.
+//!		  ex. csv.Pipeline("in.csv").Where(3, isEU).Select({1, 3, 4}).Rename(3, "total").Run("out.csv");
+class CSV_Pipeline
+{
+public:
+	using Fields = std::vector<std::string_view>;								//!< Fields of a row
+	using RowFilter = std::function<bool(const Fields& fields)>;				//!< Keeps a row when true
+	using FieldFilter = std::function<bool(std::string_view field)>;			//!< Keeps a row when true for one field
+	using FieldTransform = std::function<std::string(std::string_view field)>;	//!< Replaces one field
+
+	//! @brief Overloaded Constructor, use CSV_Utility::Pipeline instead.
+	//! @param source - [in] - the file to read.
+	//! @param delimiter - [in] - delimiting character of the source and sink.
+	//! @param bufferSize - [in] - size of each read ahead buffer in bytes.
+	//! @param depth - [in] - number of read ahead buffers.
+	//! @param ingest - [in] - INGEST_OPTION flags for reading the source.
+	//! @param quote - [in] - QUOTE_POLICY for the fields written to the sink.
+	//! @param user - [in] - name used in log entries.
+	CSV_Pipeline(const std::string source, const char delimiter, const size_t bufferSize, const int depth,
+				const int ingest, const int quote, const std::string user);
+
+	//! @brief Keep only rows the filter returns true for.
+	//! @param filter - [in] - the filter, given every field of the row.
+	//! @return CSV_Pipeline&: this pipeline.
+	CSV_Pipeline& Filter(RowFilter filter);
+
+	//! @brief Keep only rows where the filter returns true for one field.
+	//! @param column - [in] - the field passed to the filter.
+	//! @param filter - [in] - the filter.
+	//! @return CSV_Pipeline&: this pipeline.
+	CSV_Pipeline& Where(const int column, FieldFilter filter);
+
+	//! @brief Keep only the listed columns, in the listed order. A column can be listed more than once.
+	//! @param columns - [in] - the columns to keep.
+	//! @return CSV_Pipeline&: this pipeline.
+	CSV_Pipeline& Select(const std::vector<int>& columns);
+
+	//! @brief Rename a column in the header row.
+	//! @param column - [in] - the column to rename.
+	//! @param name - [in] - the new name.
+	//! @return CSV_Pipeline&: this pipeline.
+	CSV_Pipeline& Rename(const int column, const std::string name);
+
+	//! @brief Replace every value of a column with the result of a transform.
+	//! @param column - [in] - the column to transform.
+	//! @param transform - [in] - the transform, not applied to the header row.
+	//! @return CSV_Pipeline&: this pipeline.
+	CSV_Pipeline& Transform(const int column, FieldTransform transform);
+
+	//! @brief Run the pipeline, streaming the source through every step into the sink.
+	//! @note With more than one thread, batches of rows are processed in parallel by that many workers and 
+	//!		  written in source order, while the calling thread reads ahead and writes finished batches.
+	//!		  Filters and transforms must then be safe to call from several threads at once.
+	//! @param output - [in] - the sink file, replaced if it exists. Can not be the source.
+	//! @param threads - [in] - number of threads, 0 for the hardware thread count.
+	//! @return int64_t: -1 on error, else the number of rows written, not counting the header.
+	int64_t Run(const std::string output, const int threads = 1);
+
+protected:
+private:
+	//! @brief enum to hold the kinds of pipeline steps
+	enum STEP_TYPE
+	{
+		STEP_FILTER,
+		STEP_WHERE,
+		STEP_SELECT,
+		STEP_RENAME,
+		STEP_TRANSFORM,
+	};
+
+	//! @brief One recorded step.
+	struct Step
+	{
+		STEP_TYPE			type;				//!< Kind of step
+		int					column = 0;			//!< Column for Where, Rename and Transform
+		std::vector<int>	columns;			//!< Columns for Select
+		std::string			name;				//!< Name for Rename
+		RowFilter			filter;				//!< Filter for Filter
+		FieldFilter			fieldFilter;		//!< Filter for Where
+		FieldTransform		transform;			//!< Transform for Transform
+	};
+
+	//! @brief Pass one row through every step.
+	//! @param line - [in] - the row.
+	//! @param fields - [in/out] - scratch field views.
+	//! @param selected - [in/out] - scratch field views for Select.
+	//! @param scratch - [in/out] - storage for transformed values.
+	//! @param unescaped - [in/out] - storage for fields with escaped quotes.
+	//! @param out - [out] - the finished row is appended, if kept.
+	//! @return bool: true if the row was kept, else false.
+	bool ProcessRow(std::string_view line, Fields& fields, Fields& selected, std::vector<std::string>& scratch, 
+					std::string& unescaped, std::string& out);
+
+	//! @brief Pass the header row through the Select and Rename steps.
+	//! @param line - [in] - the header row.
+	//! @param out - [out] - the finished header row.
+	//! @return bool: true if every step's columns exist, else false.
+	bool ProcessHeader(std::string_view line, std::string& out);
+
+	//! @brief Cut a row into field views, removing their quoting.
+	//! @param line - [in] - the row.
+	//! @param fields - [out] - the field views.
+	//! @param unescaped - [out] - storage for fields with escaped quotes, the views may point into it.
+	void CutFields(std::string_view line, Fields& fields, std::string& unescaped);
+
+	std::string					mSource;		//!< Source filename
+	char						mDelimiter;		//!< Delimiting character
+	size_t						mBufferSize;	//!< Size of each read ahead buffer in bytes
+	int							mDepth;			//!< Number of read ahead buffers
+	int							mIngest;		//!< INGEST_OPTION flags for reading the source
+	int							mQuote;			//!< QUOTE_POLICY for the sink
+	std::string					mUser;			//!< Name used in log entries
+	std::vector<Step>			mSteps;			//!< Recorded steps, in order
+	size_t						mTransforms;	//!< Number of transform steps
+};
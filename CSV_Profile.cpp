@@ -0,0 +1,472 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_Profile.cpp
+//!
+//! @brief		Implementation for the CSV_Profile sketches
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <algorithm>					// Sorting
+#include <charconv>						// from_chars
+#include <cmath>						// Estimates
+#include <functional>					// Hashing values
+#include <limits>						// NaN
+//
+#include "CSV_Profile.h"				// Profile class header
+///////////////////////////////////////////////////////////////////////////////
+
+CSV_HyperLogLog::CSV_HyperLogLog() : mRegisters((size_t)1 << CSV_HLL_PRECISION, 0)
+{
+}
+
+void CSV_HyperLogLog::Add(const uint64_t hash)
+{
+	// Mix the hash so the register index and rank use well spread bits whatever hash was used.
+	uint64_t mixed = hash;
+	mixed ^= mixed >> 33;
+	mixed *= 0xFF51AFD7ED558CCDULL;
+	mixed ^= mixed >> 33;
+	mixed *= 0xC4CEB9FE1A85EC53ULL;
+	mixed ^= mixed >> 33;
+
+	// The top bits pick the register, the rank is the position of the first set bit in the rest.
+	size_t index = (size_t)(mixed >> (64 - CSV_HLL_PRECISION));
+	uint64_t rest = (mixed << CSV_HLL_PRECISION) | ((uint64_t)1 << (CSV_HLL_PRECISION - 1));
+	uint8_t rank = 1;
+	while ((rest & 0x8000000000000000ULL) == 0)
+	{
+		rank++;
+		rest <<= 1;
+	}
+
+	if (rank > mRegisters[index])
+	{
+		mRegisters[index] = rank;
+	}
+}
+
+void CSV_HyperLogLog::Merge(const CSV_HyperLogLog& other)
+{
+	for (size_t i = 0; i < mRegisters.size(); i++)
+	{
+		mRegisters[i] = std::max(mRegisters[i], other.mRegisters[i]);
+	}
+}
+
+double CSV_HyperLogLog::Estimate() const
+{
+	double m = (double)mRegisters.size();
+	double sum = 0;
+	size_t zeros = 0;
+	for (uint8_t rank : mRegisters)
+	{
+		sum += std::ldexp(1.0, -(int)rank);
+		zeros += rank == 0 ? 1 : 0;
+	}
+
+	// Small counts are more accurate from the number of registers never hit.
+	double estimate = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+	if (estimate <= 2.5 * m && zeros > 0)
+	{
+		estimate = m * std::log(m / (double)zeros);
+	}
+	return estimate;
+}
+
+CSV_QuantileSketch::CSV_QuantileSketch(const int k)
+{
+	mLevels.resize(1);
+	mCount = 0;
+	mMin = std::numeric_limits<double>::quiet_NaN();
+	mMax = std::numeric_limits<double>::quiet_NaN();
+	mK = k > 8 ? k : 8;
+	mRandom = 0x9E3779B97F4A7C15ULL;
+	mLevelZeroCapacity = Capacity(0);
+}
+
+void CSV_QuantileSketch::Add(const double value)
+{
+	if (mCount == 0 || value < mMin)
+	{
+		mMin = value;
+	}
+	if (mCount == 0 || value > mMax)
+	{
+		mMax = value;
+	}
+	mCount++;
+
+	mLevels[0].push_back(value);
+	if (mLevels[0].size() >= mLevelZeroCapacity)
+	{
+		Compress();
+	}
+}
+
+void CSV_QuantileSketch::Merge(const CSV_QuantileSketch& other)
+{
+	if (other.mCount == 0)
+	{
+		return;
+	}
+
+	if (mCount == 0 || other.mMin < mMin)
+	{
+		mMin = other.mMin;
+	}
+	if (mCount == 0 || other.mMax > mMax)
+	{
+		mMax = other.mMax;
+	}
+	mCount += other.mCount;
+
+	// Values keep their weight, so each level takes the other's level of the same weight.
+	if (mLevels.size() < other.mLevels.size())
+	{
+		mLevels.resize(other.mLevels.size());
+	}
+	for (size_t level = 0; level < other.mLevels.size(); level++)
+	{
+		mLevels[level].insert(mLevels[level].end(), other.mLevels[level].begin(), other.mLevels[level].end());
+	}
+	Compress();
+}
+
+double CSV_QuantileSketch::Quantile(const double q) const
+{
+	if (mCount == 0)
+	{
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+	if (q <= 0)
+	{
+		return mMin;
+	}
+	if (q >= 1)
+	{
+		return mMax;
+	}
+
+	// Walk the values in order, each standing for 2^level numbers, until the rank is reached.
+	std::vector<std::pair<double, uint64_t>> weighted;
+	uint64_t total = 0;
+	for (size_t level = 0; level < mLevels.size(); level++)
+	{
+		for (double value : mLevels[level])
+		{
+			weighted.emplace_back(value, (uint64_t)1 << level);
+			total += (uint64_t)1 << level;
+		}
+	}
+	std::sort(weighted.begin(), weighted.end());
+
+	double target = q * (double)total;
+	uint64_t rank = 0;
+	for (const std::pair<double, uint64_t>& item : weighted)
+	{
+		rank += item.second;
+		if ((double)rank >= target)
+		{
+			return item.first;
+		}
+	}
+	return mMax;
+}
+
+uint64_t CSV_QuantileSketch::Count() const
+{
+	return mCount;
+}
+
+double CSV_QuantileSketch::Min() const
+{
+	return mMin;
+}
+
+double CSV_QuantileSketch::Max() const
+{
+	return mMax;
+}
+
+size_t CSV_QuantileSketch::Capacity(const size_t level) const
+{
+	// The top level holds k values, each level below two thirds of the one above it.
+	size_t depth = mLevels.size() - level - 1;
+	double capacity = std::ceil((double)mK * std::pow(2.0 / 3.0, (double)depth));
+	return capacity > 2 ? (size_t)capacity : 2;
+}
+
+void CSV_QuantileSketch::Compress()
+{
+	for (size_t level = 0; level < mLevels.size(); level++)
+	{
+		if (mLevels[level].size() < Capacity(level))
+		{
+			continue;
+		}
+		if (level + 1 == mLevels.size())
+		{
+			mLevels.emplace_back();
+		}
+
+		// Keep one value back from an odd count, then promote every other sorted value at double weight.
+		std::vector<double>& values = mLevels[level];
+		std::sort(values.begin(), values.end());
+		bool odd = values.size() % 2 != 0;
+		double kept = odd ? values.back() : 0;
+		if (odd)
+		{
+			values.pop_back();
+		}
+
+		mRandom ^= mRandom << 13;
+		mRandom ^= mRandom >> 7;
+		mRandom ^= mRandom << 17;
+		for (size_t i = (size_t)(mRandom & 1); i < values.size(); i += 2)
+		{
+			mLevels[level + 1].push_back(values[i]);
+		}
+
+		values.clear();
+		if (odd)
+		{
+			values.push_back(kept);
+		}
+	}
+	mLevelZeroCapacity = Capacity(0);
+}
+
+CSV_TopK::CSV_TopK(const size_t capacity)
+{
+	mCapacity = capacity > 0 ? capacity : 1;
+	mEntries.reserve(mCapacity);
+	mLookup.reserve(mCapacity);
+}
+
+CSV_TopK::CSV_TopK(const CSV_TopK& other)
+{
+	mCapacity = other.mCapacity;
+	mEntries.reserve(mCapacity);
+	mEntries.assign(other.mEntries.begin(), other.mEntries.end());
+	Rebuild();
+}
+
+CSV_TopK& CSV_TopK::operator=(const CSV_TopK& other)
+{
+	if (this != &other)
+	{
+		mLookup.clear();
+		mEntries.clear();
+		mCapacity = other.mCapacity;
+		mEntries.reserve(mCapacity);
+		mEntries.assign(other.mEntries.begin(), other.mEntries.end());
+		Rebuild();
+	}
+	return *this;
+}
+
+void CSV_TopK::Add(std::string_view value)
+{
+	// Counted already.
+	auto found = mLookup.find(value);
+	if (found != mLookup.end())
+	{
+		mEntries[found->second].count++;
+		SiftDown(mPosition[found->second]);
+		return;
+	}
+
+	// A free counter, a count of 1 is the smallest so it moves up to the top of the heap.
+	if (mEntries.size() < mCapacity)
+	{
+		size_t index = mEntries.size();
+		mEntries.push_back(Entry{ std::string(value), 1, 0 });
+		mLookup.emplace(mEntries[index].value, index);
+		mHeap.push_back(index);
+		mPosition.push_back(mHeap.size() - 1);
+		for (size_t position = mHeap.size() - 1; position > 0; position = (position - 1) / 2)
+		{
+			size_t parent = (position - 1) / 2;
+			std::swap(mHeap[position], mHeap[parent]);
+			mPosition[mHeap[position]] = position;
+			mPosition[mHeap[parent]] = parent;
+		}
+		return;
+	}
+
+	// Take over the smallest counter, its count becomes the error of the new value.
+	size_t index = mHeap[0];
+	Entry& entry = mEntries[index];
+	auto node = mLookup.extract(entry.value);
+	entry.value.assign(value.data(), value.size());
+	entry.error = entry.count;
+	entry.count++;
+
+	// Reuse the lookup node, a value missing the sketch then costs no allocation.
+	node.key() = entry.value;
+	mLookup.insert(std::move(node));
+	SiftDown(0);
+}
+
+void CSV_TopK::Merge(const CSV_TopK& other)
+{
+	// A value missing from a full sketch may have been counted up to that sketch's smallest count.
+	uint64_t mine = mEntries.size() == mCapacity ? mEntries[mHeap[0]].count : 0;
+	uint64_t theirs = other.mEntries.size() == other.mCapacity ? other.mEntries[other.mHeap[0]].count : 0;
+
+	std::vector<Entry> merged;
+	merged.reserve(mEntries.size() + other.mEntries.size());
+	for (const Entry& entry : mEntries)
+	{
+		auto found = other.mLookup.find(entry.value);
+		const Entry* match = found != other.mLookup.end() ? &other.mEntries[found->second] : nullptr;
+		merged.push_back(Entry{ entry.value, entry.count + (match ? match->count : theirs), entry.error + (match ? match->error : theirs) });
+	}
+	for (const Entry& entry : other.mEntries)
+	{
+		if (mLookup.find(entry.value) == mLookup.end())
+		{
+			merged.push_back(Entry{ entry.value, entry.count + mine, entry.error + mine });
+		}
+	}
+
+	// Keep the largest counts.
+	std::sort(merged.begin(), merged.end(), [](const Entry& a, const Entry& b) { return a.count > b.count; });
+	if (merged.size() > mCapacity)
+	{
+		merged.resize(mCapacity);
+	}
+
+	mLookup.clear();
+	mEntries.clear();
+	for (Entry& entry : merged)
+	{
+		mEntries.push_back(std::move(entry));
+	}
+	Rebuild();
+}
+
+std::vector<CSV_TopK::Entry> CSV_TopK::Top(const size_t k) const
+{
+	std::vector<Entry> top(mEntries);
+	std::sort(top.begin(), top.end(), [](const Entry& a, const Entry& b) { return a.count > b.count; });
+	if (top.size() > k)
+	{
+		top.resize(k);
+	}
+	return top;
+}
+
+void CSV_TopK::Rebuild()
+{
+	mLookup.clear();
+	mHeap.resize(mEntries.size());
+	mPosition.resize(mEntries.size());
+	for (size_t i = 0; i < mEntries.size(); i++)
+	{
+		mLookup.emplace(mEntries[i].value, i);
+		mHeap[i] = i;
+		mPosition[i] = i;
+	}
+	for (size_t i = mHeap.size() / 2; i > 0; i--)
+	{
+		SiftDown(i - 1);
+	}
+}
+
+void CSV_TopK::SiftDown(size_t position)
+{
+	while (true)
+	{
+		size_t smallest = position;
+		size_t left = position * 2 + 1;
+		size_t right = left + 1;
+		if (left < mHeap.size() && mEntries[mHeap[left]].count < mEntries[mHeap[smallest]].count)
+		{
+			smallest = left;
+		}
+		if (right < mHeap.size() && mEntries[mHeap[right]].count < mEntries[mHeap[smallest]].count)
+		{
+			smallest = right;
+		}
+		if (smallest == position)
+		{
+			return;
+		}
+
+		std::swap(mHeap[position], mHeap[smallest]);
+		mPosition[mHeap[position]] = position;
+		mPosition[mHeap[smallest]] = smallest;
+		position = smallest;
+	}
+}
+
+CSVColumnProfile::CSVColumnProfile(std::string name) : name(name)
+{
+	count = 0;
+	empty = 0;
+	missing = 0;
+	numeric = 0;
+	min_length = 0;
+	max_length = 0;
+}
+
+void CSVColumnProfile::Add(std::string_view value)
+{
+	uint64_t length = (uint64_t)value.size();
+	min_length = count == 0 ? length : std::min(min_length, length);
+	max_length = count == 0 ? length : std::max(max_length, length);
+	count++;
+
+	// Empty values are only counted, they don't take space in the sketches.
+	if (value.empty())
+	{
+		empty++;
+		return;
+	}
+
+	distinct.Add((uint64_t)std::hash<std::string_view>()(value));
+	top.Add(value);
+
+	double number = 0;
+	auto result = std::from_chars(value.data(), value.data() + value.size(), number);
+	if (result.ec == std::errc() && result.ptr == value.data() + value.size() && std::isfinite(number))
+	{
+		numeric++;
+		quantiles.Add(number);
+	}
+}
+
+void CSVColumnProfile::AddMissing()
+{
+	missing++;
+}
+
+void CSVColumnProfile::Merge(const CSVColumnProfile& other)
+{
+	if (other.count > 0)
+	{
+		min_length = count == 0 ? other.min_length : std::min(min_length, other.min_length);
+		max_length = count == 0 ? other.max_length : std::max(max_length, other.max_length);
+	}
+	count += other.count;
+	empty += other.empty;
+	missing += other.missing;
+	numeric += other.numeric;
+	distinct.Merge(other.distinct);
+	quantiles.Merge(other.quantiles);
+	top.Merge(other.top);
+}
+
+uint64_t CSVColumnProfile::Distinct() const
+{
+	return (uint64_t)std::llround(distinct.Estimate());
+}
@@ -0,0 +1,195 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_Profile.h
+//!
+//! @brief		Fixed size, mergeable sketches for profiling CSV columns in one pass.
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstdint>						// Fixed width counts
+#include <string>                       // Strings
+#include <string_view>					// Views of values
+#include <unordered_map>				// Counter lookup
+#include <vector>                       // Vectors
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CSV_HLL_PRECISION			// Index bits of the distinct count sketch, 2^p one byte registers, ~1.04/sqrt(2^p) error.
+#define     CSV_HLL_PRECISION			14
+#endif
+#ifndef     CSV_QUANTILE_K				// Accuracy of the quantile sketch, ~1.65/k rank error, holds about 3k values.
+#define     CSV_QUANTILE_K				200
+#endif
+#ifndef     CSV_TOP_K_CAPACITY			// Counters of the frequent values sketch.
+#define     CSV_TOP_K_CAPACITY			64
+#endif
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! @brief HyperLogLog distinct count sketch.
+class CSV_HyperLogLog
+{
+public:
+	//! @brief Default Constructor
+	CSV_HyperLogLog();
+
+	//! @brief Add a value by its hash.
+	//! @param hash - [in] - 64 bit hash of the value, mixed again before use.
+	void Add(const uint64_t hash);
+
+	//! @brief Add the values of another sketch.
+	//! @param other - [in] - the sketch to merge.
+	void Merge(const CSV_HyperLogLog& other);
+
+	//! @brief Estimate the number of distinct values added.
+	//! @return double: the estimate.
+	double Estimate() const;
+
+private:
+	std::vector<uint8_t>	mRegisters;		//!< Highest rank seen per register
+};
+
+//! @brief KLL quantile sketch over numbers.
+class CSV_QuantileSketch
+{
+public:
+	//! @brief Overloaded Constructor
+	//! @param k - [in] - accuracy, the size of the top compactor.
+	CSV_QuantileSketch(const int k = CSV_QUANTILE_K);
+
+	//! @brief Add a number.
+	//! @param value - [in] - the number.
+	void Add(const double value);
+
+	//! @brief Add the numbers of another sketch.
+	//! @param other - [in] - the sketch to merge.
+	void Merge(const CSV_QuantileSketch& other);
+
+	//! @brief Get an approximate quantile.
+	//! @param q - [in] - rank between 0 and 1, ex. 0.5 for the median.
+	//! @return double: the quantile, NaN if no numbers were added.
+	double Quantile(const double q) const;
+
+	//! @brief Get the number of numbers added.
+	//! @return uint64_t: the count.
+	uint64_t Count() const;
+
+	//! @brief Get the exact smallest number added.
+	//! @return double: the minimum, NaN if no numbers were added.
+	double Min() const;
+
+	//! @brief Get the exact largest number added.
+	//! @return double: the maximum, NaN if no numbers were added.
+	double Max() const;
+
+private:
+	//! @brief Get the number of values a level holds before it is compacted.
+	//! @param level - [in] - the level, 0 is the newest.
+	//! @return size_t: the capacity.
+	size_t Capacity(const size_t level) const;
+
+	//! @brief Compact every full level, promoting half of its values to the next level.
+	void Compress();
+
+	std::vector<std::vector<double>>	mLevels;	//!< Values of weight 2^level
+	uint64_t							mCount;		//!< Numbers added
+	double								mMin;		//!< Smallest number added
+	double								mMax;		//!< Largest number added
+	int									mK;			//!< Accuracy
+	uint64_t							mRandom;	//!< Compaction coin flips
+	size_t								mLevelZeroCapacity;	//!< Capacity(0), checked on every Add
+};
+
+//! @brief Space-Saving sketch of the most frequent values.
+class CSV_TopK
+{
+public:
+	//! @brief A counted value.
+	struct Entry
+	{
+		std::string		value;				//!< The value
+		uint64_t		count;				//!< Count, at most error above the true count
+		uint64_t		error;				//!< Overestimate of the count
+	};
+
+	//! @brief Overloaded Constructor
+	//! @param capacity - [in] - number of counters, more counters give more accurate counts.
+	CSV_TopK(const size_t capacity = CSV_TOP_K_CAPACITY);
+
+	//! @brief Copy Constructor, rebuilds the lookup for the copied values.
+	CSV_TopK(const CSV_TopK& other);
+
+	//! @brief Copy Assignment, rebuilds the lookup for the copied values.
+	CSV_TopK& operator=(const CSV_TopK& other);
+
+	//! @brief Count a value.
+	//! @param value - [in] - the value.
+	void Add(std::string_view value);
+
+	//! @brief Add the counts of another sketch.
+	//! @param other - [in] - the sketch to merge.
+	void Merge(const CSV_TopK& other);
+
+	//! @brief Get the most frequent values.
+	//! @param k - [in] - the number of values to get, at most the capacity.
+	//! @return std::vector<Entry>: the values, most frequent first.
+	std::vector<Entry> Top(const size_t k) const;
+
+private:
+	//! @brief Rebuild the heap and lookup from the entries.
+	void Rebuild();
+
+	//! @brief Move an entry down the heap after its count grew.
+	//! @param position - [in] - heap position of the entry.
+	void SiftDown(size_t position);
+
+	std::vector<Entry>									mEntries;	//!< Counters, never reallocated so the lookup keys stay valid
+	std::vector<size_t>									mHeap;		//!< Entries ordered as a min heap on count
+	std::vector<size_t>									mPosition;	//!< Heap position of each entry
+	std::unordered_map<std::string_view, size_t>		mLookup;	//!< Entry of each value
+	size_t												mCapacity;	//!< Maximum number of counters
+};
+
+//! @brief Profile of one column, every part has a fixed size and merges with profiles of other chunks or files.
+class CSVColumnProfile
+{
+public:
+	std::string name;                       // Column name from the header row
+	int64_t count;                          // Rows that have the column
+	int64_t empty;                          // Values that are empty
+	int64_t missing;                        // Rows too short to have the column
+	int64_t numeric;                        // Values that are numbers, the quantiles are over these
+	uint64_t min_length;                    // Shortest value in bytes
+	uint64_t max_length;                    // Longest value in bytes
+	CSV_HyperLogLog distinct;               // Distinct values
+	CSV_QuantileSketch quantiles;           // Quantiles of the numeric values
+	CSV_TopK top;                           // Most frequent values
+
+	// constructor initializes everything
+	CSVColumnProfile(std::string name = "");
+
+	//! @brief Add a value of the column.
+	//! @param value - [in] - the value.
+	void Add(std::string_view value);
+
+	//! @brief Count a row too short to have the column.
+	void AddMissing();
+
+	//! @brief Add another profile of the same column.
+	//! @param other - [in] - the profile to merge.
+	void Merge(const CSVColumnProfile& other);
+
+	//! @brief Estimate the number of distinct values.
+	//! @return uint64_t: the estimate.
+	uint64_t Distinct() const;
+};
@@ -0,0 +1,282 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_ReadAhead.cpp
+//!
+//! @brief		Implementation for the CSV_ReadAhead class
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstring>						// memchr
+//
+#include "CSV_ReadAhead.h"				// Read ahead class header
+///////////////////////////////////////////////////////////////////////////////
+
+CSV_ReadAhead::CSV_ReadAhead() : CSV_ReadAhead(CSV_READ_AHEAD_SIZE, CSV_READ_AHEAD_DEPTH)
+{
+}
+
+CSV_ReadAhead::CSV_ReadAhead(const size_t bufferSize, const int depth, const int ingest, const char delimiter)
+{
+	// Need at least two buffers to overlap reading with parsing.
+	mBufferSize = bufferSize > 0 ? bufferSize : CSV_READ_AHEAD_SIZE;
+	mBuffers.resize(depth > 1 ? depth : 2);
+	mCurrent = 0;
+	mPos = 0;
+	mHaveBuffer = false;
+	mDone = false;
+	mStop = false;
+	mOpen = false;
+	mOffset = 0;
+	mIngest = ingest;
+	mDelimiter = delimiter;
+}
+
+CSV_ReadAhead::~CSV_ReadAhead()
+{
+	Close();
+}
+
+bool CSV_ReadAhead::Open(const std::string filename, const std::streamoff offset)
+{
+	// Check if we are already opened.
+	if (mOpen)
+	{
+		return false;
+	}
+
+	// Binary so the buffers hold the exact file bytes, line endings are handled in GetLine.
+	mFile.open(filename, std::ios::in | std::ios::binary);
+	if (!mFile.is_open())
+	{
+		return false;
+	}
+
+	std::streamoff start = offset > 0 ? offset : 0;
+	mFile.seekg(start, std::ios::beg);
+
+	// Reset state and queue every buffer for filling.
+	mFree.clear();
+	mFilled.clear();
+	for (size_t i = 0; i < mBuffers.size(); i++)
+	{
+		mBuffers[i].data.resize(mBufferSize);
+		mBuffers[i].size = 0;
+		mBuffers[i].last = false;
+		mFree.push_back(i);
+	}
+	mCarry.clear();
+	mOffset = start;
+	mPos = 0;
+	mHaveBuffer = false;
+	mDone = false;
+	mStop = false;
+	mOpen = true;
+
+	mReader = std::thread(&CSV_ReadAhead::ReaderThread, this);
+	return true;
+}
+
+bool CSV_ReadAhead::GetLine(std::string_view& line)
+{
+	// Only the row at the top of the file can start with a byte order mark.
+	bool first = mOffset == 0;
+	if (!NextLine(line))
+	{
+		return false;
+	}
+
+	// A quoted field can hold newlines, join lines until the row is out of its quotes.
+	if (CSV_InQuotes(line, mDelimiter, false))
+	{
+		mRecord.assign(line.data(), line.size());
+		std::string_view next;
+		bool open = true;
+		while (open && NextLine(next))
+		{
+			mRecord.push_back('\n');
+			mRecord.append(next.data(), next.size());
+			open = CSV_InQuotes(next, mDelimiter, true);
+		}
+		line = mRecord;
+	}
+
+	Normalize(line, first, mIngest);
+	return true;
+}
+
+bool CSV_ReadAhead::NextLine(std::string_view& line)
+{
+	if (!mOpen || mDone)
+	{
+		return false;
+	}
+
+	mCarry.clear();
+	bool carrying = false;
+
+	while (true)
+	{
+		// Get a buffer if we don't have one.
+		if (!mHaveBuffer || mPos >= mBuffers[mCurrent].size)
+		{
+			bool last = mHaveBuffer && mBuffers[mCurrent].last;
+			if (last || !NextBuffer())
+			{
+				// End of file, return a final line without a newline if there is one.
+				mDone = true;
+				if (carrying && !mCarry.empty())
+				{
+					line = mCarry;
+					mOffset += (std::streamoff)mCarry.size();
+					break;
+				}
+				return false;
+			}
+			continue;
+		}
+
+		// Look for the end of the line in the current buffer.
+		Buffer& buffer = mBuffers[mCurrent];
+		const char* start = buffer.data.data() + mPos;
+		size_t remaining = buffer.size - mPos;
+		const char* end = static_cast<const char*>(memchr(start, '\n', remaining));
+
+		if (end != nullptr)
+		{
+			size_t length = (size_t)(end - start);
+			mPos += length + 1;
+			mOffset += (std::streamoff)(mCarry.size() + length + 1);
+			if (carrying)
+			{
+				mCarry.append(start, length);
+				line = mCarry;
+			}
+			else
+			{
+				line = std::string_view(start, length);
+			}
+			break;
+		}
+
+		// The line continues into the next buffer, carry what we have.
+		mCarry.append(start, remaining);
+		carrying = true;
+		mPos = buffer.size;
+	}
+
+	return true;
+}
+
+void CSV_ReadAhead::Normalize(std::string_view& line, const bool first, const int ingest)
+{
+	// Drop a UTF-8 byte order mark so it doesn't end up in the first field.
+	if (first && (ingest & INGEST_OPTION::INGEST_STRIP_BOM) && line.substr(0, 3) == "\xEF\xBB\xBF")
+	{
+		line.remove_prefix(3);
+	}
+
+	// Drop a carriage return left by a CRLF line ending.
+	if ((ingest & INGEST_OPTION::INGEST_NORMALIZE_CRLF) && !line.empty() && line.back() == '\r')
+	{
+		line.remove_suffix(1);
+	}
+}
+
+std::streamoff CSV_ReadAhead::Offset()
+{
+	return mOffset;
+}
+
+bool CSV_ReadAhead::Close()
+{
+	if (!mOpen)
+	{
+		return false;
+	}
+
+	// Stop the reader and wait for it.
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mStop = true;
+	}
+	mSignal.notify_all();
+	if (mReader.joinable())
+	{
+		mReader.join();
+	}
+
+	mFile.close();
+	mFile.clear();
+	mOpen = false;
+	return true;
+}
+
+bool CSV_ReadAhead::IsOpen()
+{
+	return mOpen;
+}
+
+void CSV_ReadAhead::ReaderThread()
+{
+	while (true)
+	{
+		// Wait for a free buffer.
+		size_t index = 0;
+		{
+			std::unique_lock<std::mutex> lock(mLock);
+			mSignal.wait(lock, [this] { return mStop || !mFree.empty(); });
+			if (mStop)
+			{
+				return;
+			}
+			index = mFree.front();
+			mFree.pop_front();
+		}
+
+		// Fill it outside the lock so parsing continues in the meantime.
+		Buffer& buffer = mBuffers[index];
+		mFile.read(buffer.data.data(), (std::streamsize)buffer.data.size());
+		buffer.size = (size_t)mFile.gcount();
+		buffer.last = !mFile.good();
+
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mFilled.push_back(index);
+		}
+		mSignal.notify_all();
+
+		if (buffer.last)
+		{
+			return;
+		}
+	}
+}
+
+bool CSV_ReadAhead::NextBuffer()
+{
+	std::unique_lock<std::mutex> lock(mLock);
+
+	// Return the buffer we are done with.
+	if (mHaveBuffer)
+	{
+		mFree.push_back(mCurrent);
+		mHaveBuffer = false;
+		mSignal.notify_all();
+	}
+
+	// Wait for the next one.
+	mSignal.wait(lock, [this] { return !mFilled.empty(); });
+	mCurrent = mFilled.front();
+	mFilled.pop_front();
+	mPos = 0;
+	mHaveBuffer = true;
+	return true;
+}
@@ -0,0 +1,133 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_ReadAhead.h
+//!
+//! @brief		A read ahead line reader that overlaps file I/O with parsing.
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <fstream>						// File Stream
+#include <vector>                       // Vectors
+#include <deque>						// Buffer queues
+#include <string>                       // Strings
+#include <string_view>					// Views of lines
+#include <thread>						// Background reader
+#include <mutex>						// Data protection
+#include <condition_variable>			// Buffer hand off
+//
+#include "CSV_Info.h"					// Ingest options
+#include "CSV_Schema.h"					// Quoted fields
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CSV_READ_AHEAD_SIZE			// Default size of each read ahead buffer in bytes.
+#define     CSV_READ_AHEAD_SIZE			(1024 * 1024)
+#endif
+#ifndef     CSV_READ_AHEAD_DEPTH		// Default number of read ahead buffers.
+#define     CSV_READ_AHEAD_DEPTH		2
+#endif
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! @brief Reads a file in large buffers on a background thread and hands out lines from them.
+//! @note While the caller parses the lines of one buffer, the background thread is filling
+//!		  the next ones, hiding the read latency behind the parsing.
+class CSV_ReadAhead
+{
+public:
+	//! @brief Default Constructor
+	CSV_ReadAhead();
+
+	//! @brief Overloaded Constructor
+	//! @param bufferSize - [in] - size of each buffer in bytes.
+	//! @param depth - [in] - number of buffers, at least 2 so one can fill while one is parsed.
+	//! @param ingest - [in] - INGEST_OPTION flags, a BOM and '\r' are only dropped when set.
+	//! @param delimiter - [in] - delimiting character, needed to find quoted fields that hold newlines.
+	CSV_ReadAhead(const size_t bufferSize, const int depth, const int ingest = INGEST_DEFAULT, const char delimiter = ',');
+
+	//! @brief Default Deconstructor
+	~CSV_ReadAhead();
+
+	//! @brief Open a file and start reading ahead.
+	//! @note Opening at offset 0 skips a UTF-8 byte order mark when INGEST_STRIP_BOM is set.
+	//! @param filename - [in] - the file to read.
+	//! @param offset - [in] - byte offset to start reading from, the start of a row.
+	//! @return bool: true if successful, false if failed or already open.
+	bool Open(const std::string filename, const std::streamoff offset = 0);
+
+	//! @brief Get the next row, without its newline.
+	//! @note A row whose quoted field holds newlines spans several lines and is returned whole.
+	//! @param line - [out] - view of the row, valid until the next call.
+	//! @return bool: true if a line was read, false at the end of the file.
+	bool GetLine(std::string_view& line);
+
+	//! @brief Get the byte offset of the next line in the file.
+	//! @return std::streamoff: offset of the next line GetLine returns.
+	std::streamoff Offset();
+
+	//! @brief Apply the INGEST_OPTION normalization to a row, every reader of the utility normalizes rows here.
+	//! @param line - [in/out] - the row, without its newline, trimmed in place.
+	//! @param first - [in] - true if the row starts the file, a byte order mark is only dropped from it.
+	//! @param ingest - [in] - INGEST_OPTION flags.
+	static void Normalize(std::string_view& line, const bool first, const int ingest);
+
+	//! @brief Stop the background reader and close the file.
+	//! @return bool: true if successful, false if not open.
+	bool Close();
+
+	//! @brief Check if a file is open.
+	//! @return bool: true if open, false if closed.
+	bool IsOpen();
+
+protected:
+private:
+	//! @brief One buffer of file data.
+	struct Buffer
+	{
+		std::vector<char>	data;				//!< Buffer storage
+		size_t				size = 0;			//!< Number of valid bytes
+		bool				last = false;		//!< True if this is the final buffer of the file
+	};
+
+	//! @brief Background thread filling free buffers from the file.
+	void ReaderThread();
+
+	//! @brief Get the next line of the file as stored, a row may span several.
+	//! @param line - [out] - view of the line, valid until the next call.
+	//! @return bool: true if a line was read, false at the end of the file.
+	bool NextLine(std::string_view& line);
+
+	//! @brief Hand the current buffer back and wait for the next filled one.
+	//! @return bool: true if a buffer is available, false at the end of the file.
+	bool NextBuffer();
+
+	std::ifstream				mFile;			//!< File stream, only touched by the reader thread while open
+	std::thread					mReader;		//!< Background reader
+	std::mutex					mLock;			//!< Protects the queues and flags
+	std::condition_variable		mSignal;		//!< Signals queue changes
+	std::vector<Buffer>			mBuffers;		//!< Buffer storage
+	std::deque<size_t>			mFree;			//!< Buffers waiting to be filled
+	std::deque<size_t>			mFilled;		//!< Buffers waiting to be parsed
+	size_t						mBufferSize;	//!< Size of each buffer in bytes
+	size_t						mCurrent;		//!< Buffer being parsed
+	size_t						mPos;			//!< Parse position in the current buffer
+	bool						mHaveBuffer;	//!< True if mCurrent holds a buffer
+	bool						mDone;			//!< True once the final buffer has been parsed
+	bool						mStop;			//!< Asks the reader thread to stop
+	bool						mOpen;			//!< True while a file is open
+	std::string					mCarry;			//!< A line spanning two buffers
+	std::string					mRecord;		//!< A row spanning several lines
+	std::streamoff				mOffset;		//!< File offset of the next line
+	int							mIngest;		//!< INGEST_OPTION flags
+	char						mDelimiter;		//!< Delimiting character
+};
@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_RowCache.cpp
+//!
+//! @brief		Implementation for the CSV_RowCache class
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include "CSV_RowCache.h"				// Row cache class header
+///////////////////////////////////////////////////////////////////////////////
+
+CSV_RowCache::CSV_RowCache(const size_t capacity)
+{
+	mCapacity = capacity;
+	mBytes = 0;
+	mSize = 0;
+	mModified = 0;
+}
+
+void CSV_RowCache::SetCapacity(const size_t capacity)
+{
+	mCapacity = capacity;
+	EvictTo(capacity);
+}
+
+size_t CSV_RowCache::Capacity() const
+{
+	return mCapacity;
+}
+
+void CSV_RowCache::Validate(const uint64_t size, const int64_t modified)
+{
+	if (size != mSize || modified != mModified)
+	{
+		Clear();
+		mSize = size;
+		mModified = modified;
+	}
+}
+
+const std::vector<std::string>* CSV_RowCache::Find(const int64_t row)
+{
+	auto found = mLookup.find(row);
+	if (found == mLookup.end())
+	{
+		mStats.misses++;
+		return nullptr;
+	}
+
+	// Move the row to the front, splicing keeps the lookup's iterator valid.
+	mStats.hits++;
+	mOrder.splice(mOrder.begin(), mOrder, found->second);
+	return &found->second->values;
+}
+
+void CSV_RowCache::Insert(const int64_t row, const std::vector<std::string>& values)
+{
+	size_t bytes = SizeOf(values);
+	if (bytes > mCapacity)
+	{
+		return;
+	}
+
+	// Replace a cached copy of the row, then make room for it.
+	auto found = mLookup.find(row);
+	if (found != mLookup.end())
+	{
+		mBytes -= found->second->bytes;
+		mOrder.erase(found->second);
+		mLookup.erase(found);
+	}
+	EvictTo(mCapacity - bytes);
+
+	mOrder.push_front(Entry{ row, values, bytes });
+	mLookup[row] = mOrder.begin();
+	mBytes += bytes;
+}
+
+void CSV_RowCache::Clear()
+{
+	if (mOrder.empty())
+	{
+		return;
+	}
+
+	mOrder.clear();
+	mLookup.clear();
+	mBytes = 0;
+	mStats.invalidations++;
+}
+
+CSVRowCacheStats CSV_RowCache::Stats() const
+{
+	CSVRowCacheStats stats = mStats;
+	stats.rows = (uint64_t)mOrder.size();
+	stats.bytes = mBytes;
+	stats.capacity = mCapacity;
+	return stats;
+}
+
+size_t CSV_RowCache::SizeOf(const std::vector<std::string>& values)
+{
+	// The entry and its list node, the lookup node, then the values and their text.
+	size_t bytes = sizeof(Entry) + 2 * sizeof(void*) + sizeof(int64_t) + sizeof(std::list<Entry>::iterator) + 2 * sizeof(void*);
+	bytes += values.size() * sizeof(std::string);
+	for (const std::string& value : values)
+	{
+		bytes += value.size();
+	}
+	return bytes;
+}
+
+void CSV_RowCache::EvictTo(const size_t bytes)
+{
+	while (mBytes > bytes && !mOrder.empty())
+	{
+		mLookup.erase(mOrder.back().row);
+		mBytes -= mOrder.back().bytes;
+		mOrder.pop_back();
+		mStats.evictions++;
+	}
+}
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_RowCache.h
+//!
+//! @brief		A byte bounded, least recently used cache of parsed rows.
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstdint>						// Row numbers and counters
+#include <list>							// Recency order
+#include <string>                       // Strings
+#include <unordered_map>				// Row lookup
+#include <vector>                       // Vectors
+//
+#include "CSV_Info.h"					// Cache statistics
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! @brief Holds parsed rows by row number, dropping the least recently used rows past a byte capacity.
+//! @note The cache remembers the size and modification time of the file its rows came from,
+//!		  Validate empties it once either changes.
+class CSV_RowCache
+{
+public:
+	//! @brief Overloaded Constructor
+	//! @param capacity - [in] - most bytes of rows to hold, 0 to hold none.
+	CSV_RowCache(const size_t capacity = 0);
+
+	//! @brief Set the most bytes of rows to hold, evicting rows past it.
+	//! @param capacity - [in] - the capacity in bytes, 0 to empty the cache and hold none.
+	void SetCapacity(const size_t capacity);
+
+	//! @brief Get the most bytes of rows the cache holds.
+	//! @return size_t: the capacity in bytes, 0 if disabled.
+	size_t Capacity() const;
+
+	//! @brief Check the cache still matches the file, emptying it if the file changed.
+	//! @param size - [in] - the file's current size in bytes.
+	//! @param modified - [in] - the file's current modification time, in any fixed unit.
+	void Validate(const uint64_t size, const int64_t modified);
+
+	//! @brief Get a cached row, making it the most recently used.
+	//! @param row - [in] - the row number.
+	//! @return const std::vector<std::string>*: the row's values, nullptr if not cached.
+	const std::vector<std::string>* Find(const int64_t row);
+
+	//! @brief Cache a row, evicting the least recently used rows until it fits.
+	//! @note Rows bigger than the whole capacity are not cached.
+	//! @param row - [in] - the row number.
+	//! @param values - [in] - the row's values.
+	void Insert(const int64_t row, const std::vector<std::string>& values);
+
+	//! @brief Empty the cache because the file changed.
+	void Clear();
+
+	//! @brief Get the cache counters.
+	//! @return CSVRowCacheStats: the counters and current size.
+	CSVRowCacheStats Stats() const;
+
+private:
+	//! @brief A cached row.
+	struct Entry
+	{
+		int64_t						row;		//!< Row number
+		std::vector<std::string>	values;		//!< Parsed values
+		size_t						bytes;		//!< Estimated bytes held
+	};
+
+	//! @brief Estimate the bytes a row holds in the cache, counting the list node and lookup entry.
+	//! @param values - [in] - the row's values.
+	//! @return size_t: the estimate.
+	static size_t SizeOf(const std::vector<std::string>& values);
+
+	//! @brief Evict the least recently used rows until the cache holds at most some bytes.
+	//! @param bytes - [in] - bytes to evict down to.
+	void EvictTo(const size_t bytes);
+
+	std::list<Entry>										mOrder;		//!< Rows, most recently used first
+	std::unordered_map<int64_t, std::list<Entry>::iterator>	mLookup;	//!< Entry of each row
+	size_t													mCapacity;	//!< Most bytes to hold
+	size_t													mBytes;		//!< Bytes held
+	uint64_t												mSize;		//!< File size the rows came from
+	int64_t													mModified;	//!< File modification time the rows came from
+	CSVRowCacheStats										mStats;		//!< Counters
+};
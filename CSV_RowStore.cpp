@@ -0,0 +1,287 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_RowStore.cpp
+//!
+//! @brief		Implementation for the CSV_RowStore class
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <atomic>						// Unique spill file names
+#include <filesystem>					// Temporary directory
+//
+#include "CSV_RowStore.h"				// Row store class header
+///////////////////////////////////////////////////////////////////////////////
+
+CSV_RowStore::CSV_RowStore() : CSV_RowStore(64 * 1024 * 1024)
+{
+}
+
+CSV_RowStore::CSV_RowStore(const size_t budget)
+{
+	mBudget = budget > 0 ? budget : 1;
+	mMemory = 0;
+	mCount = 0;
+	mSpilled = false;
+	mWriteOffset = 0;
+	mReadRow = 0;
+	mReadOffset = 0;
+}
+
+CSV_RowStore::~CSV_RowStore()
+{
+	Clear();
+}
+
+void CSV_RowStore::Clear()
+{
+	std::vector<std::vector<std::string>>().swap(mRows);
+	std::vector<uint64_t>().swap(mIndex);
+	mWriteBuffer.clear();
+	mMemory = 0;
+	mCount = 0;
+	mWriteOffset = 0;
+	mReadRow = 0;
+	mReadOffset = 0;
+
+	// Remove the spill file.
+	if (mFile.is_open())
+	{
+		mFile.close();
+	}
+	if (!mSpillFile.empty())
+	{
+		std::error_code ec;
+		std::filesystem::remove(mSpillFile, ec);
+		mSpillFile.clear();
+	}
+	mSpilled = false;
+}
+
+bool CSV_RowStore::SetBudget(const size_t budget)
+{
+	if (mCount > 0 || budget == 0)
+	{
+		return false;
+	}
+
+	mBudget = budget;
+	return true;
+}
+
+bool CSV_RowStore::Append(const std::vector<std::string>& row)
+{
+	if (!mSpilled)
+	{
+		// Keep the row in memory while it fits in the budget.
+		size_t bytes = RowBytes(row);
+		if (mMemory + bytes <= mBudget)
+		{
+			mRows.push_back(row);
+			mMemory += bytes;
+			mCount++;
+			return true;
+		}
+
+		if (!Spill())
+		{
+			return false;
+		}
+	}
+
+	// Index every CSV_ROW_STORE_STRIDE'th row.
+	if (mCount % CSV_ROW_STORE_STRIDE == 0)
+	{
+		mIndex.push_back(mWriteOffset + mWriteBuffer.size());
+	}
+
+	// Rows are encoded as a field count, then each field as a length and its bytes.
+	uint32_t fields = (uint32_t)row.size();
+	mWriteBuffer.append(reinterpret_cast<const char*>(&fields), sizeof(fields));
+	for (const std::string& value : row)
+	{
+		uint32_t length = (uint32_t)value.size();
+		mWriteBuffer.append(reinterpret_cast<const char*>(&length), sizeof(length));
+		mWriteBuffer.append(value);
+	}
+	mCount++;
+
+	if (mWriteBuffer.size() >= 1024 * 1024)
+	{
+		return FlushWrites();
+	}
+	return true;
+}
+
+bool CSV_RowStore::GetRow(const size_t index, std::vector<std::string>& row)
+{
+	if (index >= mCount)
+	{
+		return false;
+	}
+
+	if (!mSpilled)
+	{
+		row = mRows[index];
+		return true;
+	}
+
+	if (!FlushWrites())
+	{
+		return false;
+	}
+
+	// Reading the next row continues from the read position, anything else starts from the indexed row before it.
+	if (index != mReadRow)
+	{
+		if (index < mReadRow || index / CSV_ROW_STORE_STRIDE != mReadRow / CSV_ROW_STORE_STRIDE)
+		{
+			mReadRow = index - index % CSV_ROW_STORE_STRIDE;
+			mReadOffset = mIndex[index / CSV_ROW_STORE_STRIDE];
+		}
+		mFile.clear();
+		mFile.seekg((std::streamoff)mReadOffset, std::ios::beg);
+		while (mReadRow < index)
+		{
+			if (!ReadNext(row))
+			{
+				return false;
+			}
+		}
+	}
+	else
+	{
+		mFile.clear();
+		mFile.seekg((std::streamoff)mReadOffset, std::ios::beg);
+	}
+
+	return ReadNext(row);
+}
+
+size_t CSV_RowStore::Size()
+{
+	return mCount;
+}
+
+bool CSV_RowStore::IsSpilled()
+{
+	return mSpilled;
+}
+
+size_t CSV_RowStore::MemoryUsed()
+{
+	if (!mSpilled)
+	{
+		return mMemory;
+	}
+	return mIndex.capacity() * sizeof(uint64_t) + mWriteBuffer.capacity();
+}
+
+std::string CSV_RowStore::GetSpillFile()
+{
+	return mSpillFile;
+}
+
+size_t CSV_RowStore::RowBytes(const std::vector<std::string>& row)
+{
+	// Short strings live inside the string object, longer ones allocate.
+	size_t bytes = sizeof(std::vector<std::string>) + row.size() * sizeof(std::string);
+	for (const std::string& value : row)
+	{
+		if (value.size() >= sizeof(std::string))
+		{
+			bytes += value.size() + 1;
+		}
+	}
+	return bytes;
+}
+
+bool CSV_RowStore::Spill()
+{
+	// Spill files go in the temporary directory, named uniquely per store.
+	static std::atomic<uint64_t> counter(0);
+	std::error_code ec;
+	std::filesystem::path directory = std::filesystem::temp_directory_path(ec);
+	std::string name = "csv_rowstore." + std::to_string(reinterpret_cast<uintptr_t>(this)) + "." + std::to_string(counter++) + ".tmp";
+	mSpillFile = (directory / name).string();
+	mFile.open(mSpillFile, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!mFile.is_open())
+	{
+		mSpillFile.clear();
+		return false;
+	}
+
+	// Move the rows held so far into the file, then release their memory.
+	std::vector<std::vector<std::string>> rows;
+	rows.swap(mRows);
+	size_t count = mCount;
+	mCount = 0;
+	mMemory = 0;
+	mSpilled = true;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!Append(rows[i]))
+		{
+			return false;
+		}
+		std::vector<std::string>().swap(rows[i]);
+	}
+	return FlushWrites();
+}
+
+bool CSV_RowStore::FlushWrites()
+{
+	if (mWriteBuffer.empty())
+	{
+		return true;
+	}
+
+	mFile.clear();
+	mFile.seekp((std::streamoff)mWriteOffset, std::ios::beg);
+	mFile.write(mWriteBuffer.data(), (std::streamsize)mWriteBuffer.size());
+	if (!mFile.good())
+	{
+		return false;
+	}
+	mWriteOffset += mWriteBuffer.size();
+	mWriteBuffer.clear();
+	return true;
+}
+
+bool CSV_RowStore::ReadNext(std::vector<std::string>& row)
+{
+	uint32_t fields = 0;
+	if (!mFile.read(reinterpret_cast<char*>(&fields), sizeof(fields)))
+	{
+		return false;
+	}
+
+	row.resize(fields);
+	uint64_t bytes = sizeof(fields);
+	for (uint32_t i = 0; i < fields; i++)
+	{
+		uint32_t length = 0;
+		mFile.read(reinterpret_cast<char*>(&length), sizeof(length));
+		row[i].resize(length);
+		if (length > 0)
+		{
+			mFile.read(&row[i][0], length);
+		}
+		bytes += sizeof(length) + length;
+	}
+	if (!mFile.good())
+	{
+		return false;
+	}
+
+	mReadRow++;
+	mReadOffset += bytes;
+	return true;
+}
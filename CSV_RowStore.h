@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_RowStore.h
+//!
+//! @brief		A row store that keeps parsed rows in memory up to a budget and on disk past it.
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <fstream>						// Spill file
+#include <vector>                       // Vectors
+#include <string>                       // Strings
+#include <cstdint>						// 64 bit offsets
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CSV_ROW_STORE_STRIDE		// Rows between indexed offsets in the spill file.
+#define     CSV_ROW_STORE_STRIDE		64
+#endif
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! @brief Holds parsed rows in memory until they pass a memory budget, then moves them to a spill
+//!		   file on disk and keeps appending there. Rows are accessed the same way in both cases.
+//! @note The spill file only keeps the offset of every CSV_ROW_STORE_STRIDE'th row in memory, 
+//!		  reading rows in order is a sequential read of the file.
+class CSV_RowStore
+{
+public:
+	//! @brief Default Constructor
+	CSV_RowStore();
+
+	//! @brief Overloaded Constructor
+	//! @param budget - [in] - bytes of rows held in memory before spilling to disk.
+	CSV_RowStore(const size_t budget);
+
+	//! @brief Default Deconstructor, removes the spill file.
+	~CSV_RowStore();
+
+	//! @brief Remove every row and the spill file, keeping the budget.
+	void Clear();
+
+	//! @brief Set the memory budget, only allowed while the store is empty.
+	//! @param budget - [in] - bytes of rows held in memory before spilling to disk.
+	//! @return bool: true if successful, false if the store holds rows or the budget is zero.
+	bool SetBudget(const size_t budget);
+
+	//! @brief Add a row to the end of the store.
+	//! @param row - [in] - the values of the row.
+	//! @return bool: true if successful, false if the spill file failed.
+	bool Append(const std::vector<std::string>& row);
+
+	//! @brief Get a row.
+	//! @param index - [in] - index of the row, starting at 0.
+	//! @param row - [out] - the values of the row.
+	//! @return bool: true if successful, false if out of range or the spill file failed.
+	bool GetRow(const size_t index, std::vector<std::string>& row);
+
+	//! @brief Get the number of rows.
+	//! @return size_t: the number of rows held.
+	size_t Size();
+
+	//! @brief Check if the rows moved to disk.
+	//! @return bool: true if the rows are in the spill file, false if in memory.
+	bool IsSpilled();
+
+	//! @brief Get the approximate bytes of memory the store holds.
+	//! @return size_t: bytes held by rows in memory, or by the index and buffers once spilled.
+	size_t MemoryUsed();
+
+	//! @brief Get the spill filename.
+	//! @return std::string: the spill file, empty if the rows are in memory.
+	std::string GetSpillFile();
+
+	//! @brief Get the approximate bytes of memory a row takes.
+	//! @param row - [in] - the row to measure.
+	//! @return size_t: bytes held by the row and its strings.
+	static size_t RowBytes(const std::vector<std::string>& row);
+
+protected:
+private:
+	//! @brief Move the rows in memory to a new spill file.
+	//! @return bool: true if successful, else false.
+	bool Spill();
+
+	//! @brief Write the pending row bytes to the spill file.
+	//! @return bool: true if successful, else false.
+	bool FlushWrites();
+
+	//! @brief Read the next row from the spill file at the read position.
+	//! @param row - [out] - the values of the row.
+	//! @return bool: true if successful, else false.
+	bool ReadNext(std::vector<std::string>& row);
+
+	std::vector<std::vector<std::string>>	mRows;	//!< Rows while in memory
+	size_t						mBudget;		//!< Bytes of rows held in memory before spilling
+	size_t						mMemory;		//!< Bytes of rows held in memory
+	size_t						mCount;			//!< Number of rows
+	bool						mSpilled;		//!< True once the rows are in the spill file
+	std::string					mSpillFile;		//!< Spill filename
+	std::fstream				mFile;			//!< Spill file stream
+	std::string					mWriteBuffer;	//!< Encoded rows waiting to be written
+	uint64_t					mWriteOffset;	//!< File offset of the end of the written rows
+	std::vector<uint64_t>		mIndex;			//!< Offset of every CSV_ROW_STORE_STRIDE'th row
+	size_t						mReadRow;		//!< Row at the read position
+	uint64_t					mReadOffset;	//!< File offset of the read position
+};
@@ -0,0 +1,467 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		CSV_Schema.h
+//!
+//! @brief		Compile time typed row schemas for the CSV Utility
+//!
+//! @author		Chip Brommer
+//!
+//! @date		< 1 / 15 / 2022 > Initial Start Date
+//!
+/*****************************************************************************/
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Include files:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <algorithm>					// Counting quotes
+#include <charconv>						// from_chars / to_chars
+#include <cmath>						// isfinite
+#include <cstring>						// memcpy
+#include <sstream>                      // Formatting types without a CSV_Field
+#include <string>                       // Strings
+#include <string_view>					// Views into a parsed line
+#include <tuple>						// Typed rows
+#include <type_traits>					// Detecting supported field types
+#include <utility>						// Index sequences
+//
+#include "CSV_Info.h"					// Quote policies
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! @brief Check if a field holds the delimiter, a quote, a carriage return or a newline.
+//! @note Eight bytes are checked at a time, so the usual field that needs no quotes costs a few 
+//!		  word operations per eight bytes rather than four compares per byte.
+inline bool CSV_NeedsQuoting(std::string_view field, const char delimiter)
+{
+	// A byte of the word matches c when word ^ (c in every byte) has a zero byte.
+	const uint64_t ones = 0x0101010101010101ULL;
+	const uint64_t highs = 0x8080808080808080ULL;
+	auto matches = [&](const uint64_t word, const unsigned char c)
+	{
+		uint64_t x = word ^ (ones * c);
+		return (x - ones) & ~x & highs;
+	};
+
+	size_t i = 0;
+	for (; i + 8 <= field.size(); i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, field.data() + i, sizeof(word));
+		if (matches(word, (unsigned char)delimiter) | matches(word, '"') | matches(word, '\n') | matches(word, '\r'))
+		{
+			return true;
+		}
+	}
+	for (; i < field.size(); i++)
+	{
+		char c = field[i];
+		if (c == delimiter || c == '"' || c == '\n' || c == '\r')
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//! @brief Quote the field at the end of a buffer if the policy asks for it, doubling the quotes inside it.
+//! @param out - [in/out] - the buffer, the field runs from start to its end.
+//! @param start - [in] - the offset of the field in the buffer.
+//! @param delimiter - [in] - the delimiter of the row.
+//! @param quote - [in] - the QUOTE_POLICY.
+inline void CSV_QuoteField(std::string& out, const size_t start, const char delimiter, const int quote)
+{
+	if (quote == QUOTE_POLICY::QUOTE_NONE)
+	{
+		return;
+	}
+
+	std::string_view field(out.data() + start, out.size() - start);
+	if (quote != QUOTE_POLICY::QUOTE_ALL && !CSV_NeedsQuoting(field, delimiter))
+	{
+		if (quote == QUOTE_POLICY::QUOTE_MINIMAL)
+		{
+			return;
+		}
+
+		// QUOTE_NON_NUMERIC leaves numbers bare, from_chars also takes inf and nan which aren't numbers here.
+		double number = 0;
+		auto result = std::from_chars(field.data(), field.data() + field.size(), number);
+		if (!field.empty() && result.ec == std::errc() && result.ptr == field.data() + field.size() && std::isfinite(number))
+		{
+			return;
+		}
+	}
+
+	// Grow the buffer and move the field back from its end, doubling quotes on the way.
+	size_t end = out.size();
+	size_t quotes = (size_t)std::count(field.begin(), field.end(), '"');
+	out.resize(end + quotes + 2);
+	size_t write = out.size();
+	out[--write] = '"';
+	for (size_t read = end; read > start; )
+	{
+		char c = out[--read];
+		out[--write] = c;
+		if (c == '"')
+		{
+			out[--write] = '"';
+		}
+	}
+	out[--write] = '"';
+}
+
+//! @brief Check if a row is still inside a quoted field at the end of some text.
+//! @note A quote only opens a field at the start of the field, ex. 5'10" is plain text. Inside a field
+//!		  a doubled quote is an escaped quote and a single quote closes it. A quoted field may hold
+//!		  newlines, so a row that ends inside one continues on the next line.
+//! @param text - [in] - a line of the row, without its newline.
+//! @param delimiter - [in] - the delimiter of the row.
+//! @param open - [in] - true if the line starts inside a quoted field, false if it starts the row.
+//! @return bool: true if the line ends inside a quoted field.
+inline bool CSV_InQuotes(std::string_view text, const char delimiter, bool open)
+{
+	size_t i = 0;
+	while (true)
+	{
+		if (open)
+		{
+			size_t close = text.find('"', i);
+			if (close == std::string_view::npos)
+			{
+				return true;
+			}
+			i = close + 1;
+			if (i < text.size() && text[i] == '"')
+			{
+				i++;
+				continue;
+			}
+			open = false;
+		}
+		else if (i < text.size() && text[i] == '"')
+		{
+			open = true;
+			i++;
+			continue;
+		}
+
+		// Skip to the start of the next field.
+		size_t next = text.find(delimiter, i);
+		if (next == std::string_view::npos)
+		{
+			return false;
+		}
+		i = next + 1;
+	}
+}
+
+//! @brief Cut the next field out of a row, removing its RFC 4180 quoting.
+//! @note Unquoted fields, and quoted fields without escaped quotes, are views into the row. Other 
+//!		  fields are unescaped onto the end of scratch and viewed there, so reserving the row's size
+//!		  in scratch keeps every view of the row valid. Text after a closing quote is kept as is.
+//!		  After the last field position is past the end of the row, read a row with 
+//!		  while (position <= row.size()), an empty row is one empty field.
+//! @param row - [in] - the row, without its newline.
+//! @param position - [in/out] - the offset of the field, moved to the offset of the next one.
+//! @param delimiter - [in] - the delimiter of the row.
+//! @param scratch - [in/out] - storage for unescaped fields, appended to and never cleared.
+//! @return std::string_view: the field's value.
+inline std::string_view CSV_NextField(std::string_view row, size_t& position, const char delimiter, std::string& scratch)
+{
+	// Plain field, up to the next delimiter.
+	if (position >= row.size() || row[position] != '"')
+	{
+		size_t next = row.find(delimiter, position);
+		if (next == std::string_view::npos)
+		{
+			next = row.size();
+		}
+		std::string_view field = row.substr(std::min(position, row.size()), next - std::min(position, row.size()));
+		position = next + 1;
+		return field;
+	}
+
+	// Quoted field, copied out only once an escaped quote is found.
+	size_t start = position + 1;
+	size_t i = start;
+	size_t mark = scratch.size();
+	bool copied = false;
+	while (true)
+	{
+		size_t close = row.find('"', i);
+		if (close == std::string_view::npos)
+		{
+			// Never closed, the rest of the row is the field.
+			position = row.size() + 1;
+			if (!copied)
+			{
+				return row.substr(start);
+			}
+			scratch.append(row.data() + i, row.size() - i);
+			return std::string_view(scratch.data() + mark, scratch.size() - mark);
+		}
+
+		if (close + 1 < row.size() && row[close + 1] == '"')
+		{
+			if (!copied)
+			{
+				scratch.append(row.data() + start, close + 1 - start);
+				copied = true;
+			}
+			else
+			{
+				scratch.append(row.data() + i, close + 1 - i);
+			}
+			i = close + 2;
+			continue;
+		}
+
+		// Closing quote, anything up to the delimiter stays part of the field.
+		size_t next = row.find(delimiter, close + 1);
+		if (next == std::string_view::npos)
+		{
+			next = row.size();
+		}
+		position = next + 1;
+		if (!copied && next == close + 1)
+		{
+			return row.substr(start, close - start);
+		}
+		if (!copied)
+		{
+			scratch.append(row.data() + start, close - start);
+		}
+		else
+		{
+			scratch.append(row.data() + i, close - i);
+		}
+		scratch.append(row.data() + close + 1, next - close - 1);
+		return std::string_view(scratch.data() + mark, scratch.size() - mark);
+	}
+}
+
+//! @brief Conversion between a single field and a value of type T.
+//! @note Only the specializations below are defined, using an unsupported type is a compile error.
+template<typename T>
+struct CSV_Field;
+
+//! @brief Conversion for integral fields.
+template<typename T>
+struct CSV_IntegralField
+{
+	static bool Parse(std::string_view field, T& value)
+	{
+		auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+		return result.ec == std::errc() && result.ptr == field.data() + field.size();
+	}
+
+	static void Format(const T& value, std::string& out)
+	{
+		char buffer[24];
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		out.append(buffer, result.ptr);
+	}
+};
+
+//! @brief Conversion for floating point fields.
+template<typename T>
+struct CSV_FloatingField
+{
+	static bool Parse(std::string_view field, T& value)
+	{
+		auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+		return result.ec == std::errc() && result.ptr == field.data() + field.size();
+	}
+
+	static void Format(const T& value, std::string& out)
+	{
+		char buffer[32];
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		out.append(buffer, result.ptr);
+	}
+};
+
+template<> struct CSV_Field<short> : CSV_IntegralField<short> {};
+template<> struct CSV_Field<unsigned short> : CSV_IntegralField<unsigned short> {};
+template<> struct CSV_Field<int> : CSV_IntegralField<int> {};
+template<> struct CSV_Field<unsigned int> : CSV_IntegralField<unsigned int> {};
+template<> struct CSV_Field<long> : CSV_IntegralField<long> {};
+template<> struct CSV_Field<unsigned long> : CSV_IntegralField<unsigned long> {};
+template<> struct CSV_Field<long long> : CSV_IntegralField<long long> {};
+template<> struct CSV_Field<unsigned long long> : CSV_IntegralField<unsigned long long> {};
+template<> struct CSV_Field<float> : CSV_FloatingField<float> {};
+template<> struct CSV_Field<double> : CSV_FloatingField<double> {};
+
+//! @brief Conversion for single character fields.
+template<>
+struct CSV_Field<char>
+{
+	static bool Parse(std::string_view field, char& value)
+	{
+		if (field.size() != 1)
+		{
+			return false;
+		}
+
+		value = field[0];
+		return true;
+	}
+
+	static void Format(const char& value, std::string& out)
+	{
+		out.push_back(value);
+	}
+};
+
+//! @brief Conversion for owning string fields.
+template<>
+struct CSV_Field<std::string>
+{
+	static bool Parse(std::string_view field, std::string& value)
+	{
+		value.assign(field.data(), field.size());
+		return true;
+	}
+
+	static void Format(const std::string& value, std::string& out)
+	{
+		out.append(value);
+	}
+};
+
+//! @brief Conversion for string view fields.
+//! @note A parsed view points into the line it was parsed from and is only valid as long as that line.
+//!		  A field with escaped quotes points into per thread storage instead, valid until the next Parse.
+template<>
+struct CSV_Field<std::string_view>
+{
+	static bool Parse(std::string_view field, std::string_view& value)
+	{
+		value = field;
+		return true;
+	}
+
+	static void Format(const std::string_view& value, std::string& out)
+	{
+		out.append(value.data(), value.size());
+	}
+};
+
+//! @brief A row schema with a fixed column count, column types and delimiter known at compile time.
+//! @note Use with CSV_Utility::ReadRow<Schema> and CSV_Utility::WriteRow<Schema>.
+template<char Delimiter, typename... Types>
+class CSV_TypedSchema
+{
+public:
+	using Row = std::tuple<Types...>;							//!< Typed row of the schema
+	static constexpr size_t columns = sizeof...(Types);		//!< Number of columns in a row
+	static constexpr char delimiter = Delimiter;				//!< Delimiting character
+
+	static_assert(sizeof...(Types) > 0, "A CSV schema needs at least one column");
+
+	//! @brief Format a row onto the end of a buffer, without a trailing newline.
+	//! @param row - [in] - the row to format.
+	//! @param out - [out] - the buffer to append to.
+	//! @param quote - [in] - the QUOTE_POLICY for the fields.
+	static void Format(const Row& row, std::string& out, const int quote = QUOTE_POLICY::QUOTE_MINIMAL)
+	{
+		FormatColumns(row, out, quote, std::index_sequence_for<Types...>{});
+	}
+
+	//! @brief Parse a line into a row.
+	//! @param line - [in] - the row to parse, without its line ending, ex. as ReadRow returns it.
+	//! @param row - [out] - the row to parse into.
+	//! @return bool: true if the line has exactly the schema's columns and every field converted, else false.
+	static bool Parse(std::string_view line, Row& row)
+	{
+		// Unescaped fields land in scratch, reserved up front so views into it stay valid.
+		thread_local std::string scratch;
+		scratch.clear();
+		scratch.reserve(line.size());
+		size_t pos = 0;
+		return ParseColumns(line, pos, row, scratch, std::index_sequence_for<Types...>{}) && pos > line.size();
+	}
+
+private:
+	template<size_t... Is>
+	static void FormatColumns(const Row& row, std::string& out, const int quote, std::index_sequence<Is...>)
+	{
+		((Is != 0 ? out.push_back(Delimiter) : void(), FormatColumn<Is>(row, out, quote)), ...);
+	}
+
+	template<size_t I>
+	static void FormatColumn(const Row& row, std::string& out, const int quote)
+	{
+		size_t start = out.size();
+		CSV_Field<std::tuple_element_t<I, Row>>::Format(std::get<I>(row), out);
+		CSV_QuoteField(out, start, Delimiter, quote);
+	}
+
+	template<size_t... Is>
+	static bool ParseColumns(std::string_view line, size_t& pos, Row& row, std::string& scratch, std::index_sequence<Is...>)
+	{
+		return (ParseColumn<Is>(line, pos, row, scratch) && ...);
+	}
+
+	template<size_t I>
+	static bool ParseColumn(std::string_view line, size_t& pos, Row& row, std::string& scratch)
+	{
+		// Ran out of columns.
+		if (pos > line.size())
+		{
+			return false;
+		}
+
+		std::string_view field = CSV_NextField(line, pos, Delimiter, scratch);
+		return CSV_Field<std::tuple_element_t<I, Row>>::Parse(field, std::get<I>(row));
+	}
+};
+
+//! @brief A comma delimited typed row schema, ex. CSV_Schema<int, double, std::string_view>
+template<typename... Types>
+using CSV_Schema = CSV_TypedSchema<',', Types...>;
+
+//! @brief True when CSV_Field has a specialization for T.
+template<typename T, typename = void>
+struct CSV_IsFieldType : std::false_type {};
+
+template<typename T>
+struct CSV_IsFieldType<T, std::void_t<decltype(&CSV_Field<T>::Format)>> : std::true_type {};
+
+//! @brief Format any value onto the end of a buffer.
+//! @note Types with a CSV_Field are formatted directly, string like types are copied and anything 
+//!		  else falls back to its stream operator, matching WriteRow(std::vector<T>).
+template<typename T>
+void CSV_FormatValue(const T& value, std::string& out)
+{
+	if constexpr (CSV_IsFieldType<T>::value)
+	{
+		CSV_Field<T>::Format(value, out);
+	}
+	else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+	{
+		std::string_view view = value;
+		out.append(view.data(), view.size());
+	}
+	else
+	{
+		std::ostringstream stream;
+		stream << value;
+		out.append(stream.str());
+	}
+}
+
+//! @brief Field list of an aggregate struct, specialize with CSV_REGISTER_FIELDS.
+template<typename T>
+struct CSV_StructFields;
+
+//! @brief Register the members of a struct that WriteRow writes, in column order.
+//! @note Use at namespace scope, ex. CSV_REGISTER_FIELDS(Sample, &Sample::time, &Sample::value)
+#define CSV_REGISTER_FIELDS(Type, ...)											\
+	template<>																	\
+	struct CSV_StructFields<Type>												\
+	{																			\
+		static constexpr auto fields = std::make_tuple(__VA_ARGS__);			\
+	}
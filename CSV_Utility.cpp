@@ -23,6 +23,22 @@ CSV_Utility::CSV_Utility()
 	mUser = "CSVUtility";
 	dCSVFileInfo.delimiter = ',';
 	mExtension = ".csv";
+	mMemoryBudget = CSV_DEFAULT_MEMORY_BUDGET;
+	mBudgetSet = false;
+	mReadAheadSize = CSV_READ_AHEAD_SIZE;
+	mReadAheadDepth = CSV_READ_AHEAD_DEPTH;
+	mDurability = DURABILITY_MODE::DURABILITY_NONE;
+	mDurabilityValue = 0;
+	mWriteTicket = 0;
+	mSyncedTicket = 0;
+	mUnsyncedRows = 0;
+	mSyncing = false;
+	mDurabilityStop = false;
+	mSyncHandle = -1;
+	mBlockRows = CSV_DEFAULT_BLOCK_ROWS;
+	mZoneMaps = false;
+	mIngest = INGEST_OPTION::INGEST_DEFAULT;
+	mQuote = QUOTE_POLICY::QUOTE_MINIMAL;
 }
 
 CSV_Utility::CSV_Utility(const std::string filename, const UTILITY_MODE mode = UTILITY_MODE::READ_WRITE_TRUNC)
@@ -32,13 +48,30 @@ CSV_Utility::CSV_Utility(const std::string filename, const UTILITY_MODE mode = U
 	dCSVFileInfo.delimiter = ',';
 	mExtension = ".csv";
 	mMode = mode;
+	mMemoryBudget = CSV_DEFAULT_MEMORY_BUDGET;
+	mBudgetSet = false;
+	mReadAheadSize = CSV_READ_AHEAD_SIZE;
+	mReadAheadDepth = CSV_READ_AHEAD_DEPTH;
+	mDurability = DURABILITY_MODE::DURABILITY_NONE;
+	mDurabilityValue = 0;
+	mWriteTicket = 0;
+	mSyncedTicket = 0;
+	mUnsyncedRows = 0;
+	mSyncing = false;
+	mDurabilityStop = false;
+	mSyncHandle = -1;
+	mBlockRows = CSV_DEFAULT_BLOCK_ROWS;
+	mZoneMaps = false;
+	mIngest = INGEST_OPTION::INGEST_DEFAULT;
+	mQuote = QUOTE_POLICY::QUOTE_MINIMAL;
 }
 
 CSV_Utility::~CSV_Utility()
 {
+	StopDurabilityThread();
 	if (mFile.is_open())
 	{
-		mFile.close();
+		CloseFile();
 	}
 }
 
@@ -65,14 +98,12 @@ int CSV_Utility::SetFileName(const std::string filename)
 bool CSV_Utility::ChangeDelimiter(const char delimiter)
 {
 	// Notify of change
-#ifdef CPP_LOGGER
-	log->AddEntry(LOG_LEVEL::LOG_ERROR, mUser, "Received new delimiter: %c", delimiter);
-#else
-	printf_s("%s - Received new delimiter: %c\n", mUser.c_str(), delimiter);
-#endif
+	CSV_LOG(CSV_LOG_INFO, EVENT_DELIMITER_CHANGED, mUser, "ChangeDelimiter", "", delimiter);
 
-	// Set the new delimiter and verify return true if good.
+	// Set the new delimiter and verify return true if good. Row bounds, cached rows and zone maps 
+	// were all read with the old delimiter.
 	dCSVFileInfo.delimiter = delimiter;
+	ClearRowIndex();
 	if (dCSVFileInfo.delimiter == delimiter)
 	{
 		return true;
@@ -92,8 +123,9 @@ bool CSV_Utility::ChangeCSVUtilityMode(const UTILITY_MODE mode)
 		mFile.close();
 	}
 
-	// Set the new mode
+	// Set the new mode, reopening may truncate the file so drop the row index.
 	mMode = mode;
+	ClearRowIndex();
 
 	// If modes equal, attempt to re-open file. 
 	if(mMode == mode)
@@ -139,7 +171,7 @@ int CSV_Utility::WriteColumnHeaders(const std::vector<std::string>& names)
 	return count;
 }
 
-bool CSV_Utility::ReadRow(std::string& values, const int row = 0)
+bool CSV_Utility::ReadRow(std::string& values, const int64_t row)
 {
 	// Make sure file is open and we are in a read mode
 	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
@@ -153,31 +185,20 @@ bool CSV_Utility::ReadRow(std::string& values, const int row = 0)
 		// if reading current position, get line and return. 
 		if (row == 0)
 		{
-			std::getline(mFile, values);
-			return true;
+			bool first = mFile.tellg() == 0;
+			ReadRecord(mFile, values, dCSVFileInfo.delimiter);
+			return IngestLine(values, first);
 		}
 
-		// Save current position and then go to top of file. 
+		// Save current position, go to the row and get the contents
 		auto curr_pos = mFile.tellg();
-		mFile.seekg(0, std::ios::beg);
-
-		// Find the row and get the contents
-		for (int i = 1; i < row+1; i++)
-		{
-			if (i == row)
-			{
-				std::getline(mFile, values);
-				break;
-			}
-
-			std::string temp;
-			std::getline(mFile, temp);
-		}
+		SeekToRow(mFile, row);
+		ReadRecord(mFile, values, dCSVFileInfo.delimiter);
 
 		// Return to position and return true
 		mFile.clear();
 		mFile.seekp(curr_pos);
-		return true;
+		return IngestLine(values, row == 1);
 	}
 	else
 	{
@@ -188,53 +209,43 @@ bool CSV_Utility::ReadRow(std::string& values, const int row = 0)
 	return false;
 }
 
-bool CSV_Utility::ReadColumn(std::vector<std::string>& values, const int column)
+int64_t CSV_Utility::ReadRows(std::vector<std::string>& values, const int64_t start, const int64_t count)
 {
 	// Make sure file is open and we are in a read mode
 	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
 	{
-		return false;
+		return -1;
 	}
 
-	// make sure column is more than 0
-	if (column < 1)
+	if (start < 1 || count < 0)
 	{
-#ifdef CPP_LOGGER
-		Log* log = log->GetInstance();
-		log->AddEntry(LOG_LEVEL::LOG_ERROR, mUser, "ReadColumn - Column input must be more than 0");
-#else
-		printf_s("%s - ReadColumn - Column input must be more than 0.\n", mUser.c_str());
-#endif
+		return -1;
 	}
 
 	// Verify file handle is good. 
 	if (mFile.good() || mFile.eof())
 	{
-		// Save current position and then go to top of file. 
+		// Save current position, go to the first row and read the range.
 		auto curr_pos = mFile.tellg();
-		mFile.seekg(0, std::ios::beg);
+		SeekToRow(mFile, start);
 
-		// Update the file info, then loop through the rows, grabbing the desired column from each row.
-		UpdateFileInfo();
-		std::vector<std::string>temp;
-		
-		for (int rowNum = 1; rowNum < dCSVFileInfo.n_rows + 1; rowNum++)
+		int64_t read = 0;
+		std::string line;
+		while (read < count && ReadRecord(mFile, line, dCSVFileInfo.delimiter))
 		{
-			std::string row;
-			int count = 0;
-			if (ReadRow(row, rowNum))
+			if (!IngestLine(line, start + read == 1))
 			{
-				temp.clear();
-				count = ParseCSVBuffer(const_cast<char*>(row.c_str()), temp);
+				read = -1;
+				break;
 			}
-
-			values.push_back(temp[static_cast<std::vector<std::string, std::allocator<std::string>>::size_type>(column) - 1]);
+			values.push_back(line);
+			read++;
 		}
-			
-		// Return to position and return true
+
+		// Return to position and return the number read
 		mFile.clear();
 		mFile.seekp(curr_pos);
-		return true;
+		return read;
 	}
 	else
 	{
@@ -242,445 +253,564 @@ bool CSV_Utility::ReadColumn(std::vector<std::string>& values, const int column)
 	}
 
 	// Default return
-	return false;
+	return -1;
 }
 
-bool CSV_Utility::RemoveRow(const int row)
+int CSV_Utility::ReadParsedRow(std::vector<std::string>& values, const int64_t row)
 {
-	// Make sure input value is within scope of the file. 
-	if (row < 1 || row > dCSVFileInfo.n_rows)
+	values.clear();
+	if (row < 1)
 	{
-		return false;
+		return -1;
 	}
 
-	// TODO
-
-	/*
-	Set file handle to beginning of file
-	Open a temp file.
-	Copy contents into temp file excluding the line desired to be removed. 
-	Close both file handlers.
-	Remove the original file. 
-	Rename the temp file to the original file.
-	Reopen to file handler. 
-	*/
+	// Writes through this utility empty the cache, other writers show in the file's size or time.
+	if (mRowCache.Capacity() > 0)
+	{
+		std::error_code sizeError;
+		std::error_code timeError;
+		uint64_t size = (uint64_t)std::filesystem::file_size(dCSVFileInfo.filename, sizeError);
+		auto modified = std::filesystem::last_write_time(dCSVFileInfo.filename, timeError);
+		if (sizeError || timeError)
+		{
+			mRowCache.Clear();
+		}
+		else
+		{
+			mRowCache.Validate(size, (int64_t)modified.time_since_epoch().count());
+		}
 
-	return false;
-}
+		const std::vector<std::string>* cached = mRowCache.Find(row);
+		if (cached != nullptr)
+		{
+			values = *cached;
+			return (int)values.size();
+		}
+	}
 
-bool CSV_Utility::RemoveColumn(const int column)
-{
-	// Make sure input value is within scope of the file. 
-	if (column < 1 || column > dCSVFileInfo.n_cols)
+	// Read and parse it, then keep it for the next read.
+	std::string line;
+	if (!ReadRow(line, row) || ParseCSVBuffer(line.data(), values) < 0)
 	{
-		return false; 
+		return -1;
 	}
+	if (mRowCache.Capacity() > 0)
+	{
+		mRowCache.Insert(row, values);
+	}
+	return (int)values.size();
+}
 
-	// TODO
-
-	/*
-	Set file handle to beginning of file.
-	Open a temp file.
-	Get line data and parse into a vector. 
-	Remove the element desired. 
-	Write data to the temp excluding the volumn.
-	Close both handles.
-	Remove the original file.
-	Rename the temp file to the original file.
-	Reopen to file handler.
-	*/
+bool CSV_Utility::SetRowCache(const size_t bytes)
+{
+	mRowCache.SetCapacity(bytes);
+	return mRowCache.Capacity() == bytes;
+}
 
-	return false;
+bool CSV_Utility::GetRowCacheStats(CSVRowCacheStats& stats)
+{
+	stats = mRowCache.Stats();
+	return mRowCache.Capacity() > 0;
 }
 
-int CSV_Utility::GetColumnHeaders(std::vector<std::string>& names)
+int64_t CSV_Utility::BernoulliSampleRows(std::vector<std::string>& values, const double probability, const uint64_t seed)
 {
-	// Make sure file is open and we are in a read mode
-	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+	if (dCSVFileInfo.filename.empty() || !(probability >= 0.0 && probability <= 1.0))
 	{
-		return false;
+		return -1;
 	}
 
-	// Verify file handle is good.  
-	if (mFile.good() || mFile.eof())
-	{
-		// Read row 1 and parse the data to get the names.
-		std::string row;
-		int count = 0;
-		if (ReadRow(row, 1))
-		{
-			count = ParseCSVBuffer(const_cast<char*>(row.c_str()), names);
-		}
-
-		// Return
-		return count;
-	}
-	else
+	// Make sure rows written through this utility are in the file.
+	if (mFile.is_open())
 	{
-		CatchFailReason();
+		mFile.flush();
 	}
 
-	// Default Return
-	return 0;
-}
-
-int CSV_Utility::GetNumberOfColumns()
-{
-	// Make sure file is open and we are in a read mode
-	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+	CSV_ReadAhead file(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+	if (!file.Open(dCSVFileInfo.filename))
 	{
 		return -1;
 	}
 
-	// Verify file handle is good. 
-	if (mFile.good() || mFile.eof())
+	// Skip the column headers.
+	std::string_view line;
+	file.GetLine(line);
+
+	int64_t sampled = 0;
+	if (probability > 0.0)
 	{
-		// Get the number of columns in row 1.
-		std::string row;
-		int count = 0;
-		bool r = ReadRow(row, 1);
-		if (r)
+		// Draw the gap to the next kept row instead of a coin flip per row.
+		std::mt19937_64 generator = SampleGenerator(seed);
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+		double logKeep = std::log1p(-probability);
+		auto nextGap = [&]() -> int64_t
 		{
-			std::vector < std::string> values;
-			count = ParseCSVBuffer(const_cast<char*>(row.c_str()), values);
-		}
+			if (probability >= 1.0)
+			{
+				return 0;
+			}
+			double u = uniform(generator);
+			return (int64_t)std::floor(std::log(1.0 - u) / logKeep);
+		};
 
-		// return number of columns
-		return count;
-	}
-	else
-	{
-		CatchFailReason();
+		int64_t skip = nextGap();
+		size_t before = values.size();
+		while (file.GetLine(line))
+		{
+			if (skip > 0)
+			{
+				skip--;
+				continue;
+			}
+
+			// CSV_ReadAhead already normalized the row. A failed row fails the sample, none of its rows are kept.
+			if (!IsIngestValid(line))
+			{
+				values.resize(before);
+				file.Close();
+				return -1;
+			}
+			values.emplace_back(line);
+			sampled++;
+			skip = nextGap();
+		}
 	}
 
-	// Default return
-	return 0;
+	file.Close();
+	return sampled;
 }
 
-int CSV_Utility::GetNumberOfRows()
+int64_t CSV_Utility::ReservoirSampleRows(std::vector<std::string>& values, const int64_t k, const uint64_t seed)
 {
-	// Make sure file is open and we are in a read mode
-	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+	if (dCSVFileInfo.filename.empty() || k < 0)
 	{
 		return -1;
 	}
 
-	// Verify file handle is good. 
-	if (mFile.good() || mFile.eof())
-	{
-		// Get current position - then move to top of file. 
-		auto curr_pos = mFile.tellg();
-		mFile.seekg(0, std::ios::beg);
+	std::mt19937_64 generator = SampleGenerator(seed);
 
-		// While loop to count numbers of rows. 
-		int count = 0;
-		std::string line = "";
-		while (getline(mFile, line))
+	// With a row index, pick the rows up front and seek straight to them.
+	if (!mRowIndex.empty() && mFile.is_open() && (mFile.good() || mFile.eof()))
+	{
+		int64_t rows = mRowIndex.back().first_row + mRowIndex.back().n_rows - 1;
+		int64_t dataRows = rows - 1;
+		if (k < dataRows)
 		{
-			count++;
+			// Floyd's algorithm for k distinct rows out of [2, rows].
+			std::vector<int64_t> picked;
+			picked.reserve((size_t)k);
+			std::unordered_set<int64_t> chosen;
+			for (int64_t j = dataRows - k; j < dataRows; j++)
+			{
+				int64_t t = std::uniform_int_distribution<int64_t>(0, j)(generator);
+				int64_t pick = chosen.count(t) ? j : t;
+				chosen.insert(pick);
+				picked.push_back(pick + 2);
+			}
+			std::sort(picked.begin(), picked.end());
+
+			// Read the rows in file order, seeking only when a row lies in a later block.
+			auto curr_pos = mFile.tellg();
+			size_t before = values.size();
+			int64_t next = -1;
+			std::string line;
+			bool valid = true;
+			for (int64_t row : picked)
+			{
+				if (next < 0 || (row - 1) / mBlockRows != (next - 1) / mBlockRows)
+				{
+					SeekToRow(mFile, row);
+					next = row;
+				}
+				for (; next < row; next++)
+				{
+					ReadRecord(mFile, line, dCSVFileInfo.delimiter);
+				}
+				ReadRecord(mFile, line, dCSVFileInfo.delimiter);
+				next++;
+
+				// A failed row fails the sample, none of its rows are kept.
+				if (!IngestLine(line, false))
+				{
+					values.resize(before);
+					valid = false;
+					break;
+				}
+				values.push_back(line);
+			}
+
+			mFile.clear();
+			mFile.seekp(curr_pos);
+			return valid ? k : -1;
 		}
+	}
 
-		// Clear the state, return to position and return count
-		mFile.clear();
-		mFile.seekp(curr_pos);
-		return count;
+	// Make sure rows written through this utility are in the file.
+	if (mFile.is_open())
+	{
+		mFile.flush();
 	}
-	else
+
+	CSV_ReadAhead file(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+	if (!file.Open(dCSVFileInfo.filename))
 	{
-		CatchFailReason();
+		return -1;
 	}
 
-	// Default return
-	return -1;
-}
+	// Skip the column headers.
+	std::string_view line;
+	file.GetLine(line);
 
-bool CSV_Utility::WriteAFullCSV(const std::string filename, const std::vector<std::vector<std::string>>& values)
-{
-	// Get the current file info and save it - then close the file.
-	std::string currFile = dCSVFileInfo.filename;
-	auto currMode = mMode;
-	std::streampos currPos;
-	bool fileOpen = false;
-	char currDelim = dCSVFileInfo.delimiter;
-	if (mFile.is_open())
+	// Fill the reservoir, then replace entries with skips between replacements (Algorithm L).
+	std::vector<std::string> reservoir;
+	reservoir.reserve((size_t)k);
+	while ((int64_t)reservoir.size() < k && file.GetLine(line))
 	{
-		fileOpen = true;
-		currPos = mFile.tellg();
-		CloseFile();
+		reservoir.emplace_back(line);
 	}
 
-	// Set the new file info
-	dCSVFileInfo.filename = filename;
-	mMode = UTILITY_MODE::WRITE_TRUNC;
-	dCSVFileInfo.delimiter = ',';
-
-	// Open the file, if successful, write the data. 
-	if (OpenFile())
+	if (k > 0 && (int64_t)reservoir.size() == k)
 	{
-		for (int i = 0; i < values.size(); i++)
+		std::uniform_real_distribution<double> uniform(std::numeric_limits<double>::min(), 1.0);
+		std::uniform_int_distribution<int64_t> slot(0, k - 1);
+		double w = std::exp(std::log(uniform(generator)) / (double)k);
+		int64_t skip = (int64_t)std::floor(std::log(uniform(generator)) / std::log1p(-w));
+		while (file.GetLine(line))
 		{
-			int r = WriteRow(values[i]);
-
-			if (r < 0)
+			if (skip > 0)
 			{
-				return false;
+				skip--;
+				continue;
 			}
-		}
 
-		CloseFile();
+			reservoir[(size_t)slot(generator)].assign(line.data(), line.size());
+			w *= std::exp(std::log(uniform(generator)) / (double)k);
+			skip = (int64_t)std::floor(std::log(uniform(generator)) / std::log1p(-w));
+		}
 	}
 
-	// Reopen the original file if it was opened. 
-	if (fileOpen)
-	{
-		dCSVFileInfo.filename = currFile;
-		dCSVFileInfo.delimiter = currDelim;
-		mMode = currMode;
+	file.Close();
 
-		if (OpenFile())
+	// CSV_ReadAhead already normalized the rows, only validation is left.
+	for (const std::string& row : reservoir)
+	{
+		if (!IsIngestValid(row))
 		{
-			// Return to position
-			mFile.clear();
-			mFile.seekp(currPos);
-			return true;
+			return -1;
 		}
-
-		return false;
 	}
-
-	// Default return
-	return true;
+	values.insert(values.end(), reservoir.begin(), reservoir.end());
+	return (int64_t)reservoir.size();
 }
 
-int CSV_Utility::ParseCSVBuffer(char* buffer, std::vector<std::string>& values)
+bool CSV_Utility::UpdateCell(const int64_t row, const int column, const std::string value)
 {
-	// Make sure file is open and we are in a read mode
-	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+	// Make sure the column is valid.
+	if (column < 1)
 	{
 		return false;
 	}
 
-	// Make sure no fail bits are set. 
-	if (mFile.good() || mFile.eof())
-	{
-		// Returns first value from the buffer prior to the delimiter
-		char* nextToken = NULL;
-		char* token = strtok_s(buffer, &dCSVFileInfo.delimiter, &nextToken);
+	return UpdateRowData(row, column, { value });
+}
 
-		// While there are more values in the string, attempt to parse at the delimiter
-		while (token != NULL)
-		{
-			values.push_back(token);
-			token = strtok_s(NULL, &dCSVFileInfo.delimiter, &nextToken);
-		}
+bool CSV_Utility::UpdateRow(const int64_t row, const std::vector<std::string>& values)
+{
+	return UpdateRowData(row, 0, values);
+}
 
-		// Return the number of values found
-		return (int)values.size();
+bool CSV_Utility::Flush()
+{
+	// Wait out any fsync in progress before the file may be swapped.
+	std::unique_lock<std::mutex> sync(mSyncLock);
+	mSyncSignal.wait(sync, [this] { return !mSyncing; });
+	std::lock_guard<std::mutex> lock(mWriteLock);
+
+	if (!mFile.is_open())
+	{
+		return false;
 	}
-	else
+
+	// Get written rows out of the stream buffer.
+	mFile.flush();
+	if (mPendingEdits.empty())
 	{
-		CatchFailReason();
+		return !mFile.bad();
 	}
-	
-	// Default return
-	return 0;
-}
 
-bool CSV_Utility::ParseAnyCSVFile(const std::string filename, std::vector<std::vector<std::string>>& values)
-{
-	// Open the file.
-	std::fstream file;
-	file.open(filename, UTILITY_MODE::READ);
-	if (file.is_open())
+	// Stream the file into a temporary, swapping in the pending rows.
+	std::string filename = dCSVFileInfo.filename;
+	std::string temp = TempFileName(filename, "update", 0);
+	std::error_code ec;
 	{
-		// grab the data from the file and push into a 2D vector of strings.
-		std::string temp;
-		while (std::getline(file, temp))
+		std::ifstream in(filename, std::ios::in | std::ios::binary);
+		std::ofstream out(temp, std::ios::out | std::ios::trunc | std::ios::binary);
+		if (!in.is_open() || !out.is_open())
 		{
-			std::vector<std::string> data;
-			char* nextToken = NULL;
-			char* token = strtok_s(const_cast<char*>(temp.c_str()), &dCSVFileInfo.delimiter, &nextToken);
+			return false;
+		}
 
-			// While there are more values in the string, attempt to parse at the delimiter
-			while (token != NULL)
+		std::string line;
+		int64_t row = 0;
+		auto next = mPendingEdits.begin();
+		while (ReadRecord(in, line, dCSVFileInfo.delimiter))
+		{
+			row++;
+			if (next != mPendingEdits.end() && next->first == row)
 			{
-				data.push_back(token);
-				token = strtok_s(NULL, &dCSVFileInfo.delimiter, &nextToken);
+				// Keep the row's line ending.
+				bool cr = !line.empty() && line.back() == '\r';
+				out << next->second;
+				if (cr)
+				{
+					out << '\r';
+				}
+				++next;
+			}
+			else
+			{
+				out << line;
 			}
 
-			values.push_back(data);
+			// The last line keeps a missing newline missing.
+			if (!in.eof())
+			{
+				out << '\n';
+			}
 		}
 
-		// Close and return
-		file.close();
-		return true;
+		out.flush();
+		if (!out.good())
+		{
+			out.close();
+			std::filesystem::remove(temp, ec);
+			return false;
+		}
 	}
 
-	// Default return
-	return false;
+	// Make the rewrite durable, then swap it in.
+	if (!SyncPath(temp))
+	{
+		std::filesystem::remove(temp, ec);
+		return false;
+	}
+
+	mPendingEdits.clear();
+	return SwapInFile(temp);
 }
 
-void CSV_Utility::PrintCSVData()
+bool CSV_Utility::PrependHeader(const std::vector<std::string>& names)
+{
+	return RewriteHeader(names, false);
+}
+
+bool CSV_Utility::ReplaceHeader(const std::vector<std::string>& names)
+{
+	return RewriteHeader(names, true);
+}
+
+bool CSV_Utility::BuildRowIndex(const int64_t blockRows, const bool zoneMaps)
 {
 	// Make sure file is open and we are in a read mode
 	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
 	{
-		return;
+		return false;
 	}
 
-	// Make sure no fail bits are set. 
-	if (mFile.good() || mFile.eof())
+	if (blockRows < 1)
 	{
-		// Save current position
-		auto curr_pos = mFile.tellg();
+		return false;
+	}
 
-		// Seek to the top and print the entire file. 
-		mFile.seekg(0, std::ios::beg);
-		std::string line;
-		while (std::getline(mFile, line))
-		{
-			printf("%s\n", line.c_str());
-		}
+	// Make sure rows written through this utility are in the file before indexing it.
+	mFile.flush();
+	ClearRowIndex();
 
-		// Clear the state and return to position
-		mFile.clear();
-		mFile.seekp(curr_pos);
-		return;
-	}
-	else
+	CSV_ReadAhead file(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+	if (!file.Open(dCSVFileInfo.filename))
 	{
-		CatchFailReason();
+		return false;
 	}
-}
 
-bool CSV_Utility::PrintAnyCSVFile(const std::string filename)
-{
-	// 2D vector to hold the file contents. 
-	std::vector<std::vector<std::string>> data;
+	// Running min/max of a column within the current block, kept both as strings and as numbers.
+	struct Accumulator
+	{
+		std::string textMin, textMax, numberMin, numberMax;
+		double low = 0, high = 0;
+		bool any = false;
+	};
+	std::vector<Accumulator> accumulators;
 
-	// Open the file and parse, print if successful
-	if(ParseAnyCSVFile(filename, data))
+	std::vector<std::string> fields;
+	std::string_view line;
+	int64_t row = 0;
+	std::streamoff offset = file.Offset();
+	while (file.GetLine(line))
 	{
-		if (data.size() > 0)
+		row++;
+
+		// Start a new block every blockRows rows.
+		if ((row - 1) % blockRows == 0)
+		{
+			mRowIndex.emplace_back(row, 0, (int64_t)offset);
+			accumulators.clear();
+		}
+		CSVBlockInfo& block = mRowIndex.back();
+		block.n_rows++;
+		offset = file.Offset();
+
+		// Row 1 holds the column headers, not data.
+		if (!zoneMaps || row == 1)
+		{
+			continue;
+		}
+
+		SplitLine(std::string(line), dCSVFileInfo.delimiter, fields);
+		int64_t dataRows = block.n_rows - (block.first_row == 1 ? 1 : 0);
+		if (fields.size() > block.columns.size())
 		{
-			// Print column headers
-			for (int i = 0; i < data[0].size(); i++)
+			// New columns count as empty for the earlier rows of the block.
+			size_t previous = block.columns.size();
+			block.columns.resize(fields.size());
+			accumulators.resize(fields.size());
+			for (size_t c = previous; c < block.columns.size(); c++)
+			{
+				block.columns[c].nulls = dataRows - 1;
+			}
+		}
+
+		for (size_t c = 0; c < block.columns.size(); c++)
+		{
+			CSVColumnStats& stats = block.columns[c];
+			if (c >= fields.size() || fields[c].empty())
+			{
+				stats.nulls++;
+				continue;
+			}
+
+			Accumulator& acc = accumulators[c];
+			const std::string& value = fields[c];
+			if (!acc.any || value < acc.textMin)
 			{
-				printf("\tCol %d", i + 1);
+				acc.textMin = value;
+			}
+			if (!acc.any || value > acc.textMax)
+			{
+				acc.textMax = value;
 			}
-			printf("\n");
 
-			// Print vector data.
-			for (int i = 0; i < data.size(); i++)
+			double number = 0;
+			if (stats.numeric && CSV_Field<double>::Parse(value, number))
 			{
-				if (data[0].size() < 1)
+				if (!acc.any || number < acc.low)
 				{
-					return false;
+					acc.low = number;
+					acc.numberMin = value;
 				}
-
-				printf("Row %d:\t", i + 1);
-				for (int j = 0; j < data[i].size(); j++)
+				if (!acc.any || number > acc.high)
 				{
-					std::string it = data[i][j];
-					printf("%s \t", it.c_str());
+					acc.high = number;
+					acc.numberMax = value;
 				}
-				printf("\n");
 			}
-		}
-
-		// Return true
-		return true;
-	}
-
-	// Default return
-	return false;
-}
-
-bool CSV_Utility::IsEndOfFile()
-{
-	return mFile.eof();
-}
-
-bool CSV_Utility::GetFileInfo(CSVFileInfo& info)
-{
-	// Update info
-	UpdateFileInfo();
-
-	// If file info is valid, set the data
-	if (dCSVFileInfo.Valid())
-	{
-		info = dCSVFileInfo;
+			else
+			{
+				stats.numeric = false;
+			}
+			acc.any = true;
 
-		return true;
+			// Keep the block's min and max current for whichever comparison applies.
+			stats.min = stats.numeric ? acc.numberMin : acc.textMin;
+			stats.max = stats.numeric ? acc.numberMax : acc.textMax;
+		}
 	}
 
-	// Default return
-	return false;
+	file.Close();
+	mBlockRows = blockRows;
+	mZoneMaps = zoneMaps;
+	return true;
 }
 
-bool CSV_Utility::GetFileInfo(std::string& filename, double size, int columns, int rows)
+bool CSV_Utility::GetRowIndex(std::vector<CSVBlockInfo>& blocks)
 {
-	// Update info
-	UpdateFileInfo();
-
-	// If file info is valid, set the data
-	if (dCSVFileInfo.Valid())
+	if (mRowIndex.empty())
 	{
-		filename = dCSVFileInfo.filename;
-		size = (double)dCSVFileInfo.filesize;
-		columns = dCSVFileInfo.n_cols;
-		rows = dCSVFileInfo.n_rows;
-
-		return true;
+		return false;
 	}
 
-	// Default return
-	return false;
+	blocks = mRowIndex;
+	return true;
 }
 
-bool CSV_Utility::ClearFile()
+int64_t CSV_Utility::ReadRowsInRange(const int column, const std::string low, const std::string high, std::vector<std::string>& rows)
 {
-	// Close the file if open.
-	if (mFile.is_open())
-	{
-		mFile.close();
-	}
-
-	// While the filename isnt empty
-	if (!dCSVFileInfo.filename.empty())
+	// Make sure file is open and we are in a read mode
+	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
 	{
-		// Open the file as output and truncating to clear all content - then re-close.
-		mFile.open(dCSVFileInfo.filename, UTILITY_MODE::WRITE_TRUNC);
-		mFile.close();
-
-		return true;
+		return -1;
 	}
 
-	// Default return - Filename empty if here. 
-	return false;
-}
-
-size_t CSV_Utility::GetFileSize()
-{
-	// Check if file is not open. 
-	if (!mFile.is_open())
+	// Needs the zone maps and a valid column.
+	if (mRowIndex.empty() || !mZoneMaps || column < 1)
 	{
 		return -1;
 	}
 
+	double number = 0;
+	bool numericBounds = CSV_Field<double>::Parse(low, number) && CSV_Field<double>::Parse(high, number);
+
 	if (mFile.good() || mFile.eof())
 	{
-		// Save current position and then go to top of file. 
+		// Save current position.
 		auto curr_pos = mFile.tellg();
 
-		// Seek to end and get the size
-		long fsize = 0;
-		mFile.seekg(0, std::ios::end);
-		fsize = (long)mFile.tellg();
+		int64_t found = 0;
+		std::string line;
+		std::vector<std::string> fields;
+		for (const CSVBlockInfo& block : mRowIndex)
+		{
+			// Skip blocks with no values for the column, or whose values all lie outside the range.
+			if ((size_t)column > block.columns.size())
+			{
+				continue;
+			}
+			const CSVColumnStats& stats = block.columns[column - 1];
+			int64_t dataRows = block.n_rows - (block.first_row == 1 ? 1 : 0);
+			bool numeric = numericBounds && stats.numeric;
+			if (stats.nulls >= dataRows || CompareValues(stats.max, low, numeric) < 0 || CompareValues(stats.min, high, numeric) > 0)
+			{
+				continue;
+			}
 
-		// Return to position and return the size
+			// Scan the block.
+			mFile.clear();
+			mFile.seekg(block.offset, std::ios::beg);
+			for (int64_t r = block.first_row; r < block.first_row + block.n_rows && ReadRecord(mFile, line, dCSVFileInfo.delimiter); r++)
+			{
+				if (r == 1 || !IngestLine(line, false))
+				{
+					continue;
+				}
+
+				SplitLine(line, dCSVFileInfo.delimiter, fields);
+				if ((size_t)column > fields.size() || fields[column - 1].empty())
+				{
+					continue;
+				}
+
+				const std::string& value = fields[column - 1];
+				if (CompareValues(value, low, numericBounds) >= 0 && CompareValues(value, high, numericBounds) <= 0)
+				{
+					rows.push_back(line);
+					found++;
+				}
+			}
+		}
+
+		// Clear the state and return to position
+		mFile.clear();
 		mFile.seekp(curr_pos);
-		return fsize;
+		return found;
 	}
 	else
 	{
@@ -691,119 +821,2146 @@ size_t CSV_Utility::GetFileSize()
 	return -1;
 }
 
-bool CSV_Utility::OpenFile()
+bool CSV_Utility::ReadColumn(std::vector<std::string>& values, const int column)
 {
-	// Check if filename has been set.
-	if (dCSVFileInfo.filename.empty())
+	// Make sure file is open and we are in a read mode
+	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
 	{
 		return false;
 	}
 
-	// Check if we are already opened. 
-	if (mFile.is_open())
+	// make sure column is more than 0
+	if (column < 1)
 	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_INVALID_COLUMN, mUser, "ReadColumn", "", column);
 		return false;
 	}
 
-	// Get the Logger instance if its included
-#ifdef CPP_LOGGER
-	Log* log = log->GetInstance();
-#endif
-
-	// Verify outputFile is a valid file path / file name
-	size_t i = dCSVFileInfo.filename.rfind('/', dCSVFileInfo.filename.length());
-	if (i == std::string::npos)
+	// Verify file handle is good. 
+	if (mFile.good() || mFile.eof())
 	{
-#ifdef CPP_LOGGER
-		log->AddEntry(LOG_LEVEL::LOG_ERROR, mUser, "Log path is not a valid path.");
-#else
-		printf_s("%s - Log path is not a valid path.\n", mUser.c_str());
-#endif
-		return false;
-	}
-	std::string directoryPath = dCSVFileInfo.filename.substr(0, i);
+		// Save current position and then go to top of file. 
+		auto curr_pos = mFile.tellg();
+		mFile.clear();
+		mFile.seekg(0, std::ios::beg);
 
-	// Make the directory if it doesn't exist
-	struct stat st = { 0 };
-	if (stat(directoryPath.c_str(), &st) == -1)
-	{
-		int made = 0;
-#ifdef _WIN32
-		made = _mkdir(directoryPath.c_str());
-#else
-		made = mkdir(directoryPath.c_str(), 0777);
-#endif
-		if (made == -1)
+		// Read the rows in one pass, grabbing the desired column from each row. A short row has an empty value.
+		std::string row;
+		std::vector<std::string> temp;
+		bool result = true;
+		for (int64_t rowNum = 1; ReadRecord(mFile, row, dCSVFileInfo.delimiter); rowNum++)
 		{
-			char buffer[256];
-			strerror_s(buffer, sizeof(buffer), errno); // get string message from errno, XSI-compliant version
-#ifdef CPP_LOGGER
-			log->AddEntry(LOG_LEVEL::LOG_ERROR, mUser, "Error %s", buffer);
-#else
-			printf_s("%s - Error %s\n", mUser.c_str(), buffer);
-#endif
-			return false;
+			if (!IngestLine(row, rowNum == 1))
+			{
+				result = false;
+				break;
+			}
+			SplitLine(row, dCSVFileInfo.delimiter, temp);
+			values.push_back(column <= (int)temp.size() ? temp[(size_t)column - 1] : std::string());
 		}
-	}
-
-	// Check if outputFile has an extension, if not, add default extension.
-	if (!std::filesystem::path(dCSVFileInfo.filename).has_extension())
-	{
-		dCSVFileInfo.filename += mExtension;
-#ifdef CPP_LOGGER
-		log->AddEntry(LOG_LEVEL::LOG_INFO, mUser, "OpenFile - filename has no extension, adding default extension: %s", mExtension.c_str());
-#else
-		printf_s("%s - OpenFile - filename has no extension, adding default extension: %s.\n", mUser.c_str(), mExtension.c_str());
-#endif
-	}
-
-	// open
-	mFile.open(dCSVFileInfo.filename, mMode);
-	if (!mFile.is_open())
-	{
-#ifdef CPP_LOGGER
-		log->AddEntry(LOG_LEVEL::LOG_ERROR, mUser, "Failed to open the output file.");
-#else
-		printf_s("%s - Failed to open the output file.\n", mUser.c_str());
-#endif
-		return false;
-	}
-
-	if (mFile.good())
-	{
-		// Get file data. 
-		UpdateFileInfo();
-
-		// Success
-#ifdef CPP_LOGGER
-		log->AddEntry(LOG_LEVEL::LOG_INFO, mUser, "File open successful: %s", dCSVFileInfo.filename.c_str());
-#else
-		printf_s("%s - File open successful: %s\n", mUser.c_str(), dCSVFileInfo.filename.c_str());
-#endif
-		return true;
+			
+		// Return to position
+		mFile.clear();
+		mFile.seekp(curr_pos);
+		return result;
 	}
 	else
 	{
 		CatchFailReason();
 	}
+
+	// Default return
 	return false;
 }
 
-bool CSV_Utility::IsFileOpen()
+int64_t CSV_Utility::ReadNumericColumn(const int column, std::vector<double>& values, const double missing)
 {
-	return mFile.is_open();
+	return ReadNumericValues(column, values, missing);
 }
 
-bool CSV_Utility::CloseFile()
+int64_t CSV_Utility::ReadNumericColumn(const int column, std::vector<int64_t>& values, const int64_t missing)
 {
-	// Check if the file is open.
-	if (mFile.is_open())
+	return ReadNumericValues(column, values, missing);
+}
+
+bool CSV_Utility::RemoveRow(const int row)
+{
+	// Make sure input value is within scope of the file. 
+	if (row < 1 || row > dCSVFileInfo.n_rows)
 	{
-		// Close the file, clear the filename and reset the file flag
-		mFile.close();
-		dCSVFileInfo.filename = "";
+		return false;
+	}
 
-		// Verify file is closed and return appropriately. 
+	// TODO
+
+	/*
+	Set file handle to beginning of file
+	Open a temp file.
+	Copy contents into temp file excluding the line desired to be removed. 
+	Close both file handlers.
+	Remove the original file. 
+	Rename the temp file to the original file.
+	Reopen to file handler. 
+	*/
+
+	return false;
+}
+
+bool CSV_Utility::RemoveColumn(const int column)
+{
+	// Make sure input value is within scope of the file. 
+	if (column < 1 || column > dCSVFileInfo.n_cols)
+	{
+		return false; 
+	}
+
+	// TODO
+
+	/*
+	Set file handle to beginning of file.
+	Open a temp file.
+	Get line data and parse into a vector. 
+	Remove the element desired. 
+	Write data to the temp excluding the volumn.
+	Close both handles.
+	Remove the original file.
+	Rename the temp file to the original file.
+	Reopen to file handler.
+	*/
+
+	return false;
+}
+
+int CSV_Utility::GetColumnHeaders(std::vector<std::string>& names)
+{
+	// Make sure file is open and we are in a read mode
+	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+	{
+		return false;
+	}
+
+	// Verify file handle is good.  
+	if (mFile.good() || mFile.eof())
+	{
+		// Read row 1 and parse the data to get the names.
+		std::string row;
+		int count = 0;
+		if (ReadRow(row, 1))
+		{
+			count = ParseCSVBuffer(const_cast<char*>(row.c_str()), names);
+		}
+
+		// Return
+		return count;
+	}
+	else
+	{
+		CatchFailReason();
+	}
+
+	// Default Return
+	return 0;
+}
+
+int CSV_Utility::GetNumberOfColumns()
+{
+	// Make sure file is open and we are in a read mode
+	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+	{
+		return -1;
+	}
+
+	// Verify file handle is good. 
+	if (mFile.good() || mFile.eof())
+	{
+		// Get the number of columns in row 1.
+		std::string row;
+		int count = 0;
+		bool r = ReadRow(row, 1);
+		if (r)
+		{
+			std::vector < std::string> values;
+			count = ParseCSVBuffer(const_cast<char*>(row.c_str()), values);
+		}
+
+		// return number of columns
+		return count;
+	}
+	else
+	{
+		CatchFailReason();
+	}
+
+	// Default return
+	return 0;
+}
+
+int CSV_Utility::GetNumberOfRows()
+{
+	int64_t rows = 0;
+	if (GetNumberOfRows(rows))
+	{
+		return (int)rows;
+	}
+
+	// Default return
+	return -1;
+}
+
+bool CSV_Utility::GetNumberOfRows(int64_t& rows)
+{
+	// Make sure file is open and we are in a read mode
+	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+	{
+		return false;
+	}
+
+	// Verify file handle is good. 
+	if (mFile.good() || mFile.eof())
+	{
+		// Get current position - then move to top of file. 
+		auto curr_pos = mFile.tellg();
+		mFile.seekg(0, std::ios::beg);
+
+		// While loop to count numbers of rows. 
+		int64_t count = 0;
+		std::string line = "";
+		while (ReadRecord(mFile, line, dCSVFileInfo.delimiter))
+		{
+			count++;
+		}
+
+		// Clear the state, return to position and return count
+		mFile.clear();
+		mFile.seekp(curr_pos);
+		rows = count;
+		return true;
+	}
+	else
+	{
+		CatchFailReason();
+	}
+
+	// Default return
+	return false;
+}
+
+bool CSV_Utility::WriteAFullCSV(const std::string filename, const std::vector<std::vector<std::string>>& values, const bool atomic, 
+								const int threads)
+{
+	// Get the current file info and save it - then close the file.
+	std::string currFile = dCSVFileInfo.filename;
+	auto currMode = mMode;
+	std::streampos currPos;
+	bool fileOpen = false;
+	char currDelim = dCSVFileInfo.delimiter;
+	if (mFile.is_open())
+	{
+		fileOpen = true;
+		currPos = mFile.tellg();
+		CloseFile();
+	}
+
+	// Atomic writes go to a temporary file that is renamed over the target once it is durable.
+	std::string target = filename;
+	if (atomic && !std::filesystem::path(target).has_extension())
+	{
+		target += mExtension;
+	}
+
+	// Set the new file info
+	dCSVFileInfo.filename = atomic ? TempFileName(target, "atomic", 0) : filename;
+	mMode = UTILITY_MODE::WRITE_TRUNC;
+
+	// Open the file, if successful, write the data with the current delimiter. 
+	std::string writing = dCSVFileInfo.filename;
+	bool result = OpenFile();
+	if (result)
+	{
+		size_t count = threads > 0 ? (size_t)threads : (size_t)std::thread::hardware_concurrency();
+		result = WriteRowBatches(values, std::max<size_t>(1, count));
+
+		// fsync before the rename publishes the new contents.
+		if (result && atomic)
+		{
+			result = SyncRows();
+		}
+		CloseFile();
+
+		if (atomic)
+		{
+			std::error_code ec;
+			if (result)
+			{
+				std::filesystem::rename(writing, target, ec);
+				result = !ec;
+			}
+
+			// Then sync the directory entry, or drop the temporary file so the target is left as it was.
+			if (result)
+			{
+				std::string directory = std::filesystem::path(target).parent_path().string();
+				SyncPath(directory.empty() ? "." : directory);
+			}
+			else
+			{
+				std::filesystem::remove(writing, ec);
+			}
+		}
+	}
+
+	// A failed write leaves the utility on its original file, in its original mode.
+	if (fileOpen || !result)
+	{
+		dCSVFileInfo.filename = currFile;
+		dCSVFileInfo.delimiter = currDelim;
+		mMode = currMode;
+	}
+
+	// Reopen the original file if it was opened. 
+	if (fileOpen)
+	{
+		if (!OpenFile())
+		{
+			return false;
+		}
+
+		// Return to position
+		mFile.clear();
+		mFile.seekp(currPos);
+	}
+
+	return result;
+}
+
+bool CSV_Utility::SetMemoryBudget(const size_t bytes)
+{
+	// A zero budget would force every operation to spill.
+	if (bytes == 0)
+	{
+		return false;
+	}
+
+	mMemoryBudget = bytes;
+	mBudgetSet = true;
+	return true;
+}
+
+bool CSV_Utility::SetIngestOptions(const int options)
+{
+	if (options < 0 || options > (INGEST_OPTION::INGEST_STRIP_BOM | INGEST_OPTION::INGEST_NORMALIZE_CRLF | INGEST_OPTION::INGEST_VALIDATE_UTF8))
+	{
+		return false;
+	}
+
+	mIngest = options;
+	return true;
+}
+
+bool CSV_Utility::SetQuotePolicy(const QUOTE_POLICY policy)
+{
+	if (policy < QUOTE_POLICY::QUOTE_MINIMAL || policy > QUOTE_POLICY::QUOTE_NONE)
+	{
+		return false;
+	}
+
+	mQuote = policy;
+	return true;
+}
+
+bool CSV_Utility::SetReadAhead(const size_t bufferSize, const int depth)
+{
+	// Need at least two buffers to overlap reading with parsing.
+	if (bufferSize == 0 || depth < 2)
+	{
+		return false;
+	}
+
+	mReadAheadSize = bufferSize;
+	mReadAheadDepth = depth;
+	return true;
+}
+
+bool CSV_Utility::Join(const std::string left, const std::string right, const int leftKey, const int rightKey,
+						const JOIN_TYPE type, const std::string output)
+{
+	// Make sure the key columns are valid.
+	if (leftKey < 1 || rightKey < 1)
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_INVALID_COLUMN, mUser, "Join", "", leftKey < 1 ? leftKey : rightKey);
+		return false;
+	}
+
+	// Writing the output would truncate an input before it is read.
+	std::error_code ec;
+	if (std::filesystem::equivalent(left, output, ec) || std::filesystem::equivalent(right, output, ec))
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_OUTPUT_IS_INPUT, mUser, "Join", output, 0);
+		return false;
+	}
+
+	// Build on the smaller file. 
+	uintmax_t leftSize = std::filesystem::file_size(left, ec);
+	if (ec)
+	{
+		return false;
+	}
+	uintmax_t rightSize = std::filesystem::file_size(right, ec);
+	if (ec)
+	{
+		return false;
+	}
+	bool buildIsLeft = leftSize < rightSize;
+
+	// Read the column headers from row 1, then open both inputs at their first row.
+	std::string leftHeader, rightHeader;
+	uint64_t leftOffset = 0, rightOffset = 0;
+	if (!ReadHeader(left, leftHeader, leftOffset) || !ReadHeader(right, rightHeader, rightOffset))
+	{
+		return false;
+	}
+	std::ifstream leftFile(left, std::ios::in | std::ios::binary);
+	std::ifstream rightFile(right, std::ios::in | std::ios::binary);
+	if (!leftFile.is_open() || !rightFile.is_open())
+	{
+		return false;
+	}
+	leftFile.seekg((std::streamoff)leftOffset, std::ios::beg);
+	rightFile.seekg((std::streamoff)rightOffset, std::ios::beg);
+
+	std::vector<std::string> leftNames, rightNames;
+	SplitLine(leftHeader, dCSVFileInfo.delimiter, leftNames);
+	SplitLine(rightHeader, dCSVFileInfo.delimiter, rightNames);
+	if (leftKey > (int)leftNames.size() || rightKey > (int)rightNames.size())
+	{
+		return false;
+	}
+
+	// Open the output through a second utility so rows go through the normal writer path.
+	CSV_Utility writer(output, UTILITY_MODE::WRITE_TRUNC);
+	writer.dCSVFileInfo.delimiter = dCSVFileInfo.delimiter;
+	writer.mQuote = mQuote;
+	if (!writer.OpenFile())
+	{
+		return false;
+	}
+
+	// Semi joins only keep the left columns.
+	std::vector<std::string> names = leftNames;
+	if (type != JOIN_TYPE::SEMI_JOIN)
+	{
+		names.insert(names.end(), rightNames.begin(), rightNames.end());
+	}
+	writer.WriteRow(names);
+
+	// The header is not part of either side.
+	uintmax_t buildSize = buildIsLeft ? leftSize - leftOffset : rightSize - rightOffset;
+	int buildKey = buildIsLeft ? leftKey : rightKey;
+	int probeKey = buildIsLeft ? rightKey : leftKey;
+	std::ifstream& build = buildIsLeft ? leftFile : rightFile;
+	std::ifstream& probe = buildIsLeft ? rightFile : leftFile;
+	return JoinPartitions(build, probe, buildSize, buildIsLeft, buildKey, probeKey, type, rightNames.size(), writer, 
+						  buildIsLeft ? left : right, buildIsLeft ? right : left, output, 0);
+}
+
+bool CSV_Utility::JoinPartitions(std::istream& build, std::istream& probe, const uintmax_t buildSize, const bool buildIsLeft, 
+									const int buildKey, const int probeKey, const JOIN_TYPE type, const size_t rightCols, CSV_Utility& writer, 
+									const std::string& buildName, const std::string& probeName, const std::string& base, const int depth)
+{
+	// Rows held in the hash table cost roughly three times their size on disk.
+	uintmax_t buildMemory = buildSize * 3;
+	if (buildMemory <= mMemoryBudget)
+	{
+		return HashJoinStreams(build, probe, buildIsLeft, buildKey, probeKey, type, rightCols, writer, buildName, probeName);
+	}
+
+	// Too big to fit, partition both inputs on the key so each build partition fits in the budget.
+	size_t partitions = (size_t)(buildMemory / mMemoryBudget) + 1;
+	if (partitions > 256)
+	{
+		partitions = 256;
+	}
+
+	// Every partition file is removed on the way out, whether or not the join got to it.
+	std::vector<std::string> names[2];
+	for (size_t p = 0; p < partitions; p++)
+	{
+		names[0].push_back(TempFileName(base, "join.build", p));
+		names[1].push_back(TempFileName(base, "join.probe", p));
+	}
+	std::error_code ec;
+	auto removeParts = [&names, &ec]()
+	{
+		for (int side = 0; side < 2; side++)
+		{
+			for (const std::string& name : names[side])
+			{
+				std::filesystem::remove(name, ec);
+			}
+		}
+	};
+
+	// Each level hashes with its own seed, so a partition that didn't fit spreads out when partitioned again.
+	std::istream* inputs[2] = { &build, &probe };
+	const std::string* sources[2] = { &buildName, &probeName };
+	int keys[2] = { buildKey, probeKey };
+	std::vector<std::string> fields;
+	const std::string empty;
+	bool result = true;
+	for (int side = 0; side < 2 && result; side++)
+	{
+		std::vector<std::ofstream> parts(partitions);
+		for (size_t p = 0; p < partitions && result; p++)
+		{
+			parts[p].open(names[side][p], std::ios::out | std::ios::trunc | std::ios::binary);
+			result = parts[p].is_open();
+		}
+
+		std::string line;
+		while (result && ReadRecord(*inputs[side], line, dCSVFileInfo.delimiter))
+		{
+			if (!IngestJoinLine(line, *sources[side]))
+			{
+				result = false;
+				break;
+			}
+			SplitLine(line, dCSVFileInfo.delimiter, fields);
+			const std::string& key = keys[side] <= (int)fields.size() ? fields[keys[side] - 1] : empty;
+			parts[PartitionOf(key, partitions, (uint64_t)depth)] << line << '\n';
+		}
+
+		// A full disk shows up as a failed stream.
+		for (size_t p = 0; p < partitions && result; p++)
+		{
+			parts[p].close();
+			result = !parts[p].fail();
+		}
+	}
+	if (!result)
+	{
+		removeParts();
+		return false;
+	}
+
+	// Join each partition pair, removing the temporary files as we go.
+	for (size_t p = 0; p < partitions && result; p++)
+	{
+		uintmax_t partSize = std::filesystem::file_size(names[0][p], ec);
+		if (ec)
+		{
+			result = false;
+			break;
+		}
+		{
+			std::ifstream buildPart(names[0][p], std::ios::in | std::ios::binary);
+			std::ifstream probePart(names[1][p], std::ios::in | std::ios::binary);
+			if (!buildPart.is_open() || !probePart.is_open())
+			{
+				result = false;
+				break;
+			}
+
+			// A partition that didn't shrink is one key, partitioning it again would not split it.
+			if (partSize * 3 > mMemoryBudget && (partSize >= buildSize || depth + 1 >= CSV_JOIN_MAX_DEPTH))
+			{
+				CSV_LOG(CSV_LOG_WARNING, EVENT_PARTITION_OVER_BUDGET, mUser, "Join", names[0][p], mMemoryBudget);
+				result = HashJoinStreams(buildPart, probePart, buildIsLeft, buildKey, probeKey, type, rightCols, writer, empty, empty);
+			}
+			else
+			{
+				result = JoinPartitions(buildPart, probePart, partSize, buildIsLeft, buildKey, probeKey, type, rightCols, 
+										writer, empty, empty, names[0][p], depth + 1);
+			}
+		}
+		std::filesystem::remove(names[0][p], ec);
+		std::filesystem::remove(names[1][p], ec);
+	}
+
+	removeParts();
+	return result;
+}
+
+bool CSV_Utility::HashJoinStreams(std::istream& build, std::istream& probe, const bool buildIsLeft, const int buildKey,
+									const int probeKey, const JOIN_TYPE type, const size_t rightCols, CSV_Utility& writer, 
+									const std::string& buildName, const std::string& probeName)
+{
+	// Load the build rows, keyed on the build column. Rows are kept unparsed until they match.
+	std::vector<std::string> rows;
+	std::unordered_multimap<std::string, size_t> table;
+	std::vector<std::string> fields;
+	std::string line;
+	while (ReadRecord(build, line, dCSVFileInfo.delimiter))
+	{
+		if (!IngestJoinLine(line, buildName))
+		{
+			return false;
+		}
+		SplitLine(line, dCSVFileInfo.delimiter, fields);
+		std::string key = buildKey <= (int)fields.size() ? fields[buildKey - 1] : "";
+		table.emplace(std::move(key), rows.size());
+		rows.push_back(std::move(line));
+	}
+
+	// When building on the left, remember which left rows matched for left and semi joins.
+	std::vector<bool> matched(buildIsLeft ? rows.size() : 0, false);
+	std::vector<std::string> buildFields;
+	std::vector<std::string> out;
+
+	// Stream the probe rows against the table.
+	while (ReadRecord(probe, line, dCSVFileInfo.delimiter))
+	{
+		if (!IngestJoinLine(line, probeName))
+		{
+			return false;
+		}
+		SplitLine(line, dCSVFileInfo.delimiter, fields);
+		std::string key = probeKey <= (int)fields.size() ? fields[probeKey - 1] : "";
+		auto range = table.equal_range(key);
+		bool found = range.first != range.second;
+
+		if (!buildIsLeft && type == JOIN_TYPE::SEMI_JOIN)
+		{
+			if (found && writer.WriteRow(fields) < 0)
+			{
+				return false;
+			}
+			continue;
+		}
+
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (buildIsLeft)
+			{
+				matched[it->second] = true;
+				if (type == JOIN_TYPE::SEMI_JOIN)
+				{
+					continue;
+				}
+			}
+
+			// Joined rows are always left columns followed by right columns.
+			SplitLine(rows[it->second], dCSVFileInfo.delimiter, buildFields);
+			out = buildIsLeft ? buildFields : fields;
+			const std::vector<std::string>& tail = buildIsLeft ? fields : buildFields;
+			out.insert(out.end(), tail.begin(), tail.end());
+			if (writer.WriteRow(out) < 0)
+			{
+				return false;
+			}
+		}
+
+		// Unmatched left row on a left join, pad the right columns.
+		if (!found && !buildIsLeft && type == JOIN_TYPE::LEFT_JOIN)
+		{
+			out = fields;
+			out.resize(fields.size() + rightCols);
+			if (writer.WriteRow(out) < 0)
+			{
+				return false;
+			}
+		}
+	}
+
+	// Emit the left rows that depend on the match flags.
+	if (buildIsLeft && type != JOIN_TYPE::INNER_JOIN)
+	{
+		for (size_t i = 0; i < rows.size(); i++)
+		{
+			if (type == JOIN_TYPE::SEMI_JOIN && matched[i])
+			{
+				SplitLine(rows[i], dCSVFileInfo.delimiter, out);
+			}
+			else if (type == JOIN_TYPE::LEFT_JOIN && !matched[i])
+			{
+				SplitLine(rows[i], dCSVFileInfo.delimiter, out);
+				out.resize(out.size() + rightCols);
+			}
+			else
+			{
+				continue;
+			}
+
+			if (writer.WriteRow(out) < 0)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool CSV_Utility::IngestJoinLine(std::string& line, const std::string& source)
+{
+	// Partitioned rows went through the ingest options on their way to the partitions.
+	if (source.empty())
+	{
+		return true;
+	}
+
+	std::string_view view(line);
+	CSV_ReadAhead::Normalize(view, false, mIngest);
+	if (view.size() != line.size())
+	{
+		line.assign(view.data(), view.size());
+	}
+
+	// Skipping the row would leave it out of the output without a trace, so the join fails instead.
+	if ((mIngest & INGEST_OPTION::INGEST_VALIDATE_UTF8) && !IsValidUTF8(line.data(), line.size()))
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_INVALID_UTF8, mUser, "Join", source, 0);
+		return false;
+	}
+
+	return true;
+}
+
+bool CSV_Utility::SetDurability(const DURABILITY_MODE mode, const int64_t value)
+{
+	// Rows and interval policies need a positive count.
+	if (mode != DURABILITY_MODE::DURABILITY_NONE && value < 1)
+	{
+		return false;
+	}
+
+	// Stop any running interval thread before changing the policy.
+	StopDurabilityThread();
+	{
+		std::lock_guard<std::mutex> lock(mWriteLock);
+		mDurability = mode;
+		mDurabilityValue = value;
+		mUnsyncedRows = 0;
+	}
+
+	if (mode == DURABILITY_MODE::DURABILITY_INTERVAL)
+	{
+		{
+			std::lock_guard<std::mutex> sync(mSyncLock);
+			mDurabilityStop = false;
+		}
+		mDurabilityThread = std::thread(&CSV_Utility::DurabilityThread, this);
+	}
+
+	return true;
+}
+
+bool CSV_Utility::Commit()
+{
+	return SyncRows();
+}
+
+int CSV_Utility::ParseCSVBuffer(char* buffer, std::vector<std::string>& values)
+{
+	// Make sure file is open and we are in a read mode
+	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+	{
+		return false;
+	}
+
+	// Make sure no fail bits are set. 
+	if (mFile.good() || mFile.eof())
+	{
+		// Cut the buffer at each delimiter outside quotes, keeping empty fields. An empty buffer is an
+		// empty row with no fields, not one empty field, so an empty file has no columns.
+		std::string_view row(buffer);
+		std::string unescaped;
+		size_t position = 0;
+		while (!row.empty() && position <= row.size())
+		{
+			values.emplace_back(CSV_NextField(row, position, dCSVFileInfo.delimiter, unescaped));
+		}
+
+		// Return the number of values found
+		return (int)values.size();
+	}
+	else
+	{
+		CatchFailReason();
+	}
+	
+	// Default return
+	return 0;
+}
+
+bool CSV_Utility::ParseAnyCSVFile(const std::string filename, std::vector<std::vector<std::string>>& values)
+{
+	// Open the file, the next buffers are read in the background while this one is parsed.
+	CSV_ReadAhead file(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+	if (file.Open(filename))
+	{
+		// grab the data from the file and push into a 2D vector of strings.
+		std::string_view line;
+		std::string unescaped;
+		size_t memory = 0;
+		while (file.GetLine(line))
+		{
+			// The reader already normalized the row.
+			if (!IsIngestValid(line))
+			{
+				std::vector<std::vector<std::string>>().swap(values);
+				file.Close();
+				return false;
+			}
+			std::vector<std::string> data;
+			size_t position = 0;
+			while (position <= line.size())
+			{
+				data.emplace_back(CSV_NextField(line, position, dCSVFileInfo.delimiter, unescaped));
+			}
+
+			// Stop before the rows outgrow the memory budget, if one was set.
+			memory += CSV_RowStore::RowBytes(data);
+			if (mBudgetSet && memory > mMemoryBudget)
+			{
+				CSV_LOG(CSV_LOG_ERROR, EVENT_MEMORY_BUDGET_EXCEEDED, mUser, "ParseAnyCSVFile", filename, mMemoryBudget);
+				std::vector<std::vector<std::string>>().swap(values);
+				file.Close();
+				return false;
+			}
+
+			values.push_back(data);
+		}
+
+		// Close and return
+		file.Close();
+		return true;
+	}
+
+	// Default return
+	return false;
+}
+
+bool CSV_Utility::ParseAnyCSVFile(const std::string filename, CSV_RowStore& rows)
+{
+	rows.Clear();
+	rows.SetBudget(mMemoryBudget);
+	dCSVFileInfo.spill_file.clear();
+
+	// Open the file, the next buffers are read in the background while this one is parsed.
+	CSV_ReadAhead file(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+	if (file.Open(filename))
+	{
+		// grab the data from the file and append it to the store.
+		std::string_view line;
+		std::string unescaped;
+		std::vector<std::string> data;
+		while (file.GetLine(line))
+		{
+			// The reader already normalized the row.
+			if (!IsIngestValid(line))
+			{
+				file.Close();
+				return false;
+			}
+			data.clear();
+			size_t position = 0;
+			while (position <= line.size())
+			{
+				data.emplace_back(CSV_NextField(line, position, dCSVFileInfo.delimiter, unescaped));
+			}
+
+			bool spilled = rows.IsSpilled();
+			if (!rows.Append(data))
+			{
+				file.Close();
+				return false;
+			}
+
+			// Report the switch to disk.
+			if (!spilled && rows.IsSpilled())
+			{
+				CSV_LOG(CSV_LOG_INFO, EVENT_SPILLED_TO_DISK, mUser, "ParseAnyCSVFile", rows.GetSpillFile(), mMemoryBudget);
+				dCSVFileInfo.spill_file = rows.GetSpillFile();
+			}
+		}
+
+		// Close and return
+		file.Close();
+		return true;
+	}
+
+	// Default return
+	return false;
+}
+
+void CSV_Utility::PrintCSVData()
+{
+	// Make sure file is open and we are in a read mode
+	if (!mFile.is_open() || (mMode != UTILITY_MODE::READ && mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+	{
+		return;
+	}
+
+	// Make sure no fail bits are set. 
+	if (mFile.good() || mFile.eof())
+	{
+		// Save current position
+		auto curr_pos = mFile.tellg();
+
+		// Seek to the top and copy the entire file to the console in large chunks. 
+		mFile.seekg(0, std::ios::beg);
+		std::vector<char> buffer(mReadAheadSize);
+		char last = '\n';
+		while (mFile.good())
+		{
+			mFile.read(buffer.data(), (std::streamsize)buffer.size());
+			std::streamsize n = mFile.gcount();
+			if (n <= 0)
+			{
+				break;
+			}
+			fwrite(buffer.data(), 1, (size_t)n, stdout);
+			last = buffer[(size_t)n - 1];
+		}
+
+		// Every line ends with a newline, including the last one.
+		if (last != '\n')
+		{
+			fputc('\n', stdout);
+		}
+		fflush(stdout);
+
+		// Clear the state and return to position
+		mFile.clear();
+		mFile.seekp(curr_pos);
+		return;
+	}
+	else
+	{
+		CatchFailReason();
+	}
+}
+
+bool CSV_Utility::PrintAnyCSVFile(const std::string filename)
+{
+	return RenderCSVFile(filename);
+}
+
+bool CSV_Utility::RenderCSVFile(const std::string filename, const CSVRenderOptions& options)
+{
+	if (options.first_row < 1 || options.max_rows < 0)
+	{
+		return false;
+	}
+
+	FILE* output = options.output != NULL ? options.output : stdout;
+	size_t maxWidth = options.max_width > 1 ? (size_t)options.max_width : 2;
+	std::vector<std::string> sample;
+	int64_t firstRow = options.first_row;
+
+	CSV_ReadAhead file(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+	std::string_view line;
+	if (options.tail)
+	{
+		// Only the end of the file is read, rows are numbered back from the last one.
+		if (options.max_rows == 0 || !ReadTailLines(filename, options.max_rows, mIngest, sample))
+		{
+			return false;
+		}
+		firstRow = -(int64_t)sample.size();
+	}
+	else
+	{
+		if (!file.Open(filename))
+		{
+			return false;
+		}
+
+		// Skip to the first row of the page.
+		for (int64_t row = 1; row < options.first_row && file.GetLine(line); row++)
+		{
+		}
+
+		// Hold the first rows back to size the columns.
+		int64_t sampleRows = options.sample_rows > 0 ? options.sample_rows : 1;
+		if (options.max_rows > 0 && options.max_rows < sampleRows)
+		{
+			sampleRows = options.max_rows;
+		}
+		while ((int64_t)sample.size() < sampleRows && file.GetLine(line))
+		{
+			sample.emplace_back(line);
+		}
+	}
+
+	// Column widths from the sampled rows, capped at the maximum width.
+	std::vector<std::string> fields;
+	std::vector<size_t> widths;
+	for (const std::string& row : sample)
+	{
+		SplitLine(row, dCSVFileInfo.delimiter, fields);
+		if (fields.size() > widths.size())
+		{
+			widths.resize(fields.size(), 0);
+		}
+		for (size_t c = 0; c < fields.size(); c++)
+		{
+			widths[c] = std::min(std::max(widths[c], fields[c].size()), maxWidth);
+		}
+	}
+	for (size_t c = 0; c < widths.size(); c++)
+	{
+		widths[c] = std::max(widths[c], std::string("Col ").size() + std::to_string(c + 1).size());
+	}
+	int64_t lastSampled = firstRow + (int64_t)sample.size() - 1;
+	size_t labelWidth = std::max(std::to_string(firstRow).size(), std::to_string(lastSampled).size()) + 6;
+
+	// Format into one large buffer and hand it to the output in big writes.
+	std::string buffer;
+	buffer.reserve(mReadAheadSize + 4096);
+	auto flush = [&](bool force)
+	{
+		if (force || buffer.size() >= mReadAheadSize)
+		{
+			fwrite(buffer.data(), 1, buffer.size(), output);
+			buffer.clear();
+		}
+	};
+
+	// Column names line.
+	fields.clear();
+	for (size_t c = 0; c < widths.size(); c++)
+	{
+		fields.push_back("Col " + std::to_string(c + 1));
+	}
+	AppendRenderedRow(buffer, "", labelWidth, fields, widths, maxWidth);
+
+	int64_t row = firstRow;
+	int64_t rendered = 0;
+	for (const std::string& sampled : sample)
+	{
+		SplitLine(sampled, dCSVFileInfo.delimiter, fields);
+		AppendRenderedRow(buffer, "Row " + std::to_string(row++) + ":", labelWidth, fields, widths, maxWidth);
+		rendered++;
+		flush(false);
+	}
+
+	// Stream the rest of the page.
+	if (!options.tail)
+	{
+		std::string text;
+		while ((options.max_rows == 0 || rendered < options.max_rows) && file.GetLine(line))
+		{
+			text.assign(line.data(), line.size());
+			SplitLine(text, dCSVFileInfo.delimiter, fields);
+			AppendRenderedRow(buffer, "Row " + std::to_string(row++) + ":", labelWidth, fields, widths, maxWidth);
+			rendered++;
+			flush(false);
+		}
+		file.Close();
+	}
+
+	flush(true);
+	fflush(output);
+	return true;
+}
+
+int64_t CSV_Utility::Validate(const std::string filename, std::vector<CSVViolation>& violations, const int64_t maxErrors, const int threads)
+{
+	violations.clear();
+	if (maxErrors < 0)
+	{
+		return -1;
+	}
+
+	// Size the file and take the expected column count from the first row.
+	std::ifstream in(filename, std::ios::in | std::ios::binary);
+	if (!in.is_open())
+	{
+		return -1;
+	}
+	in.seekg(0, std::ios::end);
+	std::streamoff size = in.tellg();
+	if (size <= 0)
+	{
+		return size == 0 ? 0 : -1;
+	}
+	in.close();
+
+	// A header failing UTF-8 validation is still counted, the chunk scan reports it.
+	std::string first;
+	uint64_t bodyOffset = 0;
+	ReadHeader(filename, first, bodyOffset);
+	int columns = CountFields(first, dCSVFileInfo.delimiter);
+
+	size_t count = threads > 0 ? (size_t)threads : (size_t)std::thread::hardware_concurrency();
+	count = std::max<size_t>(1, count);
+
+	// Split the file into chunks at row starts, each thread takes the next unscanned chunk until the error limit is reached.
+	size_t chunks = (size_t)((size + CSV_VALIDATE_CHUNK_SIZE - 1) / CSV_VALIDATE_CHUNK_SIZE);
+	std::vector<uint64_t> bounds;
+	if (!RowBounds(filename, 0, (uint64_t)size, chunks, count, bounds))
+	{
+		return -1;
+	}
+	std::vector<int64_t> rows(chunks, 0);
+	std::vector<std::vector<CSVViolation>> found(chunks);
+	std::atomic<size_t> next(0);
+	std::atomic<int64_t> errors(0);
+	std::atomic<bool> failed(false);
+	const char delimiter = dCSVFileInfo.delimiter;
+
+	auto worker = [&]()
+	{
+		while (!failed && (maxErrors == 0 || errors < maxErrors))
+		{
+			size_t chunk = next++;
+			if (chunk >= chunks)
+			{
+				return;
+			}
+
+			if (bounds[chunk + 1] <= bounds[chunk])
+			{
+				continue;
+			}
+			rows[chunk] = ValidateChunk(filename, bounds[chunk], bounds[chunk + 1], delimiter, columns, maxErrors, found[chunk]);
+			if (rows[chunk] < 0)
+			{
+				failed = true;
+			}
+			errors += (int64_t)found[chunk].size();
+		}
+	};
+
+	count = std::min(count, chunks);
+	std::vector<std::thread> pool;
+	for (size_t i = 1; i < count; i++)
+	{
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& thread : pool)
+	{
+		thread.join();
+	}
+
+	if (failed)
+	{
+		return -1;
+	}
+
+	// Chunks are handed out in order, so the scanned ones are a prefix of the file and
+	// their row counts give every violation its row number.
+	int64_t base = 0;
+	size_t scanned = std::min(next.load(), chunks);
+	for (size_t chunk = 0; chunk < scanned; chunk++)
+	{
+		for (CSVViolation& violation : found[chunk])
+		{
+			if (maxErrors > 0 && (int64_t)violations.size() >= maxErrors)
+			{
+				break;
+			}
+			violation.row += base;
+			violations.push_back(violation);
+		}
+		base += rows[chunk];
+	}
+
+	return (int64_t)violations.size();
+}
+
+int CSV_Utility::Split(const std::string filename, const SPLIT_STRATEGY strategy, const int64_t value, 
+						std::vector<std::string>& shards, const int keyColumn, const int threads)
+{
+	shards.clear();
+
+	// Make sure the strategy arguments are valid.
+	if (value < 1 || (strategy == SPLIT_STRATEGY::SPLIT_BY_HASH && keyColumn < 1))
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_INVALID_ARGUMENT, mUser, "Split", "", value < 1 ? value : keyColumn);
+		return -1;
+	}
+
+	// Read the header, it is repeated at the top of every shard.
+	std::error_code ec;
+	uint64_t size = std::filesystem::file_size(filename, ec);
+	std::ifstream in(filename, std::ios::in | std::ios::binary);
+	if (ec || !in.is_open())
+	{
+		return -1;
+	}
+	std::string header;
+	uint64_t bodyOffset = 0;
+	if (!ReadHeader(filename, header, bodyOffset))
+	{
+		return -1;
+	}
+	header.push_back('\n');
+
+	size_t count = threads > 0 ? (size_t)threads : (size_t)std::thread::hardware_concurrency();
+	count = std::max<size_t>(1, count);
+
+	// Start every shard with the header.
+	size_t outputs = strategy == SPLIT_STRATEGY::SPLIT_BY_ROWS ? 0 : (size_t)value;
+	std::vector<uint64_t> bounds;
+	if (strategy == SPLIT_STRATEGY::SPLIT_BY_BYTES)
+	{
+		// Equal byte ranges, each moved forward to the start of a row.
+		if (!RowBounds(filename, bodyOffset, size, outputs, count, bounds))
+		{
+			return -1;
+		}
+	}
+	else if (strategy == SPLIT_STRATEGY::SPLIT_BY_ROWS)
+	{
+		// Count newlines outside quoted fields in large blocks, a shard ends after every value rows.
+		bounds.push_back(bodyOffset);
+		in.clear();
+		in.seekg((std::streamoff)bodyOffset, std::ios::beg);
+		std::vector<char> buffer(mReadAheadSize);
+		uint64_t position = bodyOffset;
+		int64_t rows = 0;
+		bool quoted = false;
+		while (in.good())
+		{
+			in.read(buffer.data(), (std::streamsize)buffer.size());
+			size_t n = (size_t)in.gcount();
+			const char* data = buffer.data();
+			const char* end = data + n;
+			while (const char* newline = static_cast<const char*>(memchr(data, '\n', (size_t)(end - data))))
+			{
+				quoted = quoted != ((std::count(data, newline, '"') & 1) != 0);
+				data = newline + 1;
+				if (!quoted && ++rows % value == 0)
+				{
+					uint64_t next = position + (uint64_t)(data - buffer.data());
+					if (next < size)
+					{
+						bounds.push_back(next);
+					}
+				}
+			}
+			quoted = quoted != ((std::count(data, end, '"') & 1) != 0);
+			position += n;
+		}
+		bounds.push_back(size);
+		outputs = bounds.size() - 1;
+	}
+	in.close();
+
+	for (size_t i = 0; i < outputs; i++)
+	{
+		shards.push_back(ShardFileName(filename, i));
+		std::ofstream shard(shards.back(), std::ios::out | std::ios::trunc | std::ios::binary);
+		shard << header;
+		if (!shard.good())
+		{
+			return -1;
+		}
+	}
+
+	std::atomic<bool> failed(false);
+	if (strategy != SPLIT_STRATEGY::SPLIT_BY_HASH)
+	{
+		// Copy the byte ranges of all shards in parallel, the rows are never parsed.
+		RunTasks(outputs, count, [&](const size_t i)
+		{
+			if (bounds[i + 1] > bounds[i] && !CopyFileBytes(filename, shards[i], bounds[i], bounds[i + 1] - bounds[i]))
+			{
+				failed = true;
+			}
+		});
+		return failed ? -1 : (int)outputs;
+	}
+
+	// Hash partitioning. Threads scan ranges of the body, keep a buffer per output and 
+	// append a buffer to its shard under that shard's lock once it is full.
+	std::vector<std::ofstream> files(outputs);
+	std::vector<std::mutex> locks(outputs);
+	for (size_t i = 0; i < outputs; i++)
+	{
+		files[i].open(shards[i], std::ios::out | std::ios::app | std::ios::binary);
+		if (!files[i].is_open())
+		{
+			return -1;
+		}
+	}
+
+	size_t ranges = count * 4;
+	if (!RowBounds(filename, bodyOffset, size, ranges, count, bounds))
+	{
+		return -1;
+	}
+
+	size_t flushSize = std::min<size_t>(std::max<size_t>(mMemoryBudget / (count * outputs), 64 * 1024), 4 * 1024 * 1024);
+	const char delimiter = dCSVFileInfo.delimiter;
+	const int ingest = mIngest;
+	const std::vector<int> keyColumns = { keyColumn };
+	RunTasks(ranges, count, [&](const size_t range)
+	{
+		if (bounds[range + 1] <= bounds[range])
+		{
+			return;
+		}
+
+		std::ifstream input(filename, std::ios::in | std::ios::binary);
+		input.seekg((std::streamoff)bounds[range], std::ios::beg);
+		std::vector<std::string> buffers(outputs);
+		auto flush = [&](const size_t p)
+		{
+			std::lock_guard<std::mutex> lock(locks[p]);
+			files[p].write(buffers[p].data(), (std::streamsize)buffers[p].size());
+			if (!files[p].good())
+			{
+				failed = true;
+			}
+			buffers[p].clear();
+		};
+
+		std::string line, key;
+		uint64_t position = bounds[range];
+		while (position < bounds[range + 1] && ReadRecord(input, line, delimiter))
+		{
+			position += line.size() + 1;
+
+			// Cut the key field out of the row.
+			std::string_view row(line);
+			CSV_ReadAhead::Normalize(row, false, ingest);
+			KeyOf(row, keyColumns, delimiter, key);
+
+			size_t p = PartitionOf(key, outputs);
+			buffers[p] += line;
+			buffers[p].push_back('\n');
+			if (buffers[p].size() >= flushSize)
+			{
+				flush(p);
+			}
+		}
+
+		for (size_t p = 0; p < outputs; p++)
+		{
+			if (!buffers[p].empty())
+			{
+				flush(p);
+			}
+		}
+	});
+
+	for (size_t i = 0; i < outputs; i++)
+	{
+		files[i].close();
+	}
+	return failed ? -1 : (int)outputs;
+}
+
+bool CSV_Utility::Concat(const std::vector<std::string>& inputs, const std::string output)
+{
+	if (inputs.empty())
+	{
+		return false;
+	}
+
+	// Read every header first so nothing is written when the inputs don't line up.
+	std::error_code ec;
+	std::vector<std::string> headers(inputs.size());
+	std::vector<uint64_t> bodyOffsets(inputs.size(), 0);
+	std::vector<std::vector<int>> remaps(inputs.size());
+	std::vector<std::string> names, reference;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		if (std::filesystem::equivalent(inputs[i], output, ec))
+		{
+			CSV_LOG(CSV_LOG_ERROR, EVENT_OUTPUT_IS_INPUT, mUser, "Concat", output, i);
+			return false;
+		}
+
+		if (!ReadHeader(inputs[i], headers[i], bodyOffsets[i]))
+		{
+			return false;
+		}
+		SplitLine(headers[i], dCSVFileInfo.delimiter, names);
+		if (i == 0)
+		{
+			reference = names;
+			continue;
+		}
+
+		// Same columns in the same order are copied as is, another order is remapped.
+		if (names == reference)
+		{
+			continue;
+		}
+
+		std::unordered_map<std::string, int> positions;
+		for (size_t c = 0; c < names.size(); c++)
+		{
+			positions.emplace(names[c], (int)c);
+		}
+		for (const std::string& name : reference)
+		{
+			auto found = positions.find(name);
+			if (found == positions.end() || names.size() != reference.size())
+			{
+				CSV_LOG(CSV_LOG_ERROR, EVENT_COLUMNS_MISMATCH, mUser, "Concat", inputs[i], i);
+				return false;
+			}
+			remaps[i].push_back(found->second);
+		}
+	}
+
+	// Write the header once.
+	{
+		std::ofstream out(output, std::ios::out | std::ios::trunc | std::ios::binary);
+		out << headers[0] << '\n';
+		if (!out.good())
+		{
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		uint64_t size = std::filesystem::file_size(inputs[i], ec);
+		uint64_t bodyOffset = bodyOffsets[i];
+		if (ec)
+		{
+			return false;
+		}
+		if (bodyOffset >= size)
+		{
+			continue;
+		}
+
+		if (remaps[i].empty())
+		{
+			// Matching header, the body goes straight from file to file.
+			if (!CopyFileBytes(inputs[i], output, bodyOffset))
+			{
+				return false;
+			}
+
+			// Keep the next body from starting on this one's last row.
+			std::ifstream in(inputs[i], std::ios::in | std::ios::binary);
+			in.seekg(-1, std::ios::end);
+			if (in.get() != '\n')
+			{
+				std::ofstream out(output, std::ios::out | std::ios::app | std::ios::binary);
+				out << '\n';
+			}
+			continue;
+		}
+
+		// Columns in another order, stream the rows through the remap.
+		CSV_ReadAhead file(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+		std::ofstream out(output, std::ios::out | std::ios::app | std::ios::binary);
+		if (!file.Open(inputs[i], (std::streamoff)bodyOffset) || !out.is_open())
+		{
+			return false;
+		}
+
+		std::string_view line;
+		std::string text, buffer;
+		std::vector<std::string> fields;
+		while (file.GetLine(line))
+		{
+			text.assign(line.data(), line.size());
+			SplitLine(text, dCSVFileInfo.delimiter, fields);
+			for (size_t c = 0; c < remaps[i].size(); c++)
+			{
+				if (c > 0)
+				{
+					buffer.push_back(dCSVFileInfo.delimiter);
+				}
+				if (remaps[i][c] < (int)fields.size())
+				{
+					size_t start = buffer.size();
+					buffer += fields[remaps[i][c]];
+					CSV_QuoteField(buffer, start, dCSVFileInfo.delimiter, mQuote);
+				}
+			}
+			buffer.push_back('\n');
+
+			if (buffer.size() >= mReadAheadSize)
+			{
+				out.write(buffer.data(), (std::streamsize)buffer.size());
+				buffer.clear();
+			}
+		}
+		out.write(buffer.data(), (std::streamsize)buffer.size());
+		file.Close();
+		if (!out.good())
+		{
+			return false;
+		}
+	}
+
+	// Default return
+	return true;
+}
+
+CSV_Pipeline CSV_Utility::Pipeline(const std::string source)
+{
+	return CSV_Pipeline(source, dCSVFileInfo.delimiter, mReadAheadSize, mReadAheadDepth, mIngest, mQuote, mUser);
+}
+
+int64_t CSV_Utility::Diff(const std::string oldFile, const std::string newFile, const std::vector<int>& keyColumns, 
+						  const std::string output, const int threads)
+{
+	// Make sure the key columns are valid.
+	if (keyColumns.empty() || *std::min_element(keyColumns.begin(), keyColumns.end()) < 1)
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_INVALID_COLUMN, mUser, "Diff", "", keyColumns.empty() ? 0 : *std::min_element(keyColumns.begin(), keyColumns.end()));
+		return -1;
+	}
+
+	// Writing the change set would truncate a snapshot before it is read.
+	std::error_code ec;
+	if (std::filesystem::equivalent(oldFile, output, ec) || std::filesystem::equivalent(newFile, output, ec))
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_OUTPUT_IS_INPUT, mUser, "Diff", output, 0);
+		return -1;
+	}
+	uintmax_t oldSize = std::filesystem::file_size(oldFile, ec);
+	if (ec)
+	{
+		return -1;
+	}
+
+	// Open both snapshots and read the column headers from row 1.
+	CSV_ReadAhead oldRows(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+	CSV_ReadAhead newRows(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+	if (!oldRows.Open(oldFile) || !newRows.Open(newFile))
+	{
+		return -1;
+	}
+	std::string_view line;
+	if (!oldRows.GetLine(line))
+	{
+		return -1;
+	}
+	std::string header(line);
+
+	// Rows are only comparable under the same columns.
+	if (!newRows.GetLine(line) || line != header)
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_COLUMNS_MISMATCH, mUser, "Diff", newFile, 0);
+		return -1;
+	}
+
+	// The change set has the new columns, led by the kind of change.
+	std::ofstream out(output, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!out.is_open())
+	{
+		return -1;
+	}
+	out << "change" << dCSVFileInfo.delimiter << header << '\n';
+
+	size_t count = threads > 0 ? (size_t)threads : (size_t)std::thread::hardware_concurrency();
+	count = std::max<size_t>(1, count);
+
+	// Rows held in the hash tables cost roughly three times their size on disk.
+	uintmax_t oldMemory = oldSize * 3;
+	if (oldMemory <= mMemoryBudget)
+	{
+		int64_t changes = DiffStreams(oldRows, newRows, keyColumns, dCSVFileInfo.delimiter, out);
+		out.close();
+		return out.fail() ? -1 : changes;
+	}
+
+	// Too big to fit, partition both snapshots on the key so each partition fits in its share of the budget.
+	size_t partitions = (size_t)(oldMemory * count / mMemoryBudget) + 1;
+	if (partitions > 256)
+	{
+		partitions = 256;
+	}
+
+	// Every temporary file is removed on the way out, whether or not the diff got to it.
+	const char* tags[3] = { "diff.old", "diff.new", "diff.out" };
+	auto removeParts = [&]()
+	{
+		for (int tag = 0; tag < 3; tag++)
+		{
+			for (size_t p = 0; p < partitions; p++)
+			{
+				std::filesystem::remove(TempFileName(output, tags[tag], p), ec);
+			}
+		}
+	};
+
+	CSV_ReadAhead* inputs[2] = { &oldRows, &newRows };
+	bool result = true;
+	for (int side = 0; side < 2 && result; side++)
+	{
+		std::vector<std::ofstream> parts(partitions);
+		for (size_t p = 0; p < partitions && result; p++)
+		{
+			parts[p].open(TempFileName(output, tags[side], p), std::ios::out | std::ios::trunc | std::ios::binary);
+			result = parts[p].is_open();
+		}
+
+		std::string key;
+		while (result && inputs[side]->GetLine(line))
+		{
+			KeyOf(line, keyColumns, dCSVFileInfo.delimiter, key);
+			std::ofstream& part = parts[PartitionOf(key, partitions)];
+			part.write(line.data(), (std::streamsize)line.size());
+			part.put('\n');
+		}
+		inputs[side]->Close();
+
+		// A full disk shows up as a failed stream.
+		for (size_t p = 0; p < partitions && result; p++)
+		{
+			parts[p].close();
+			result = !parts[p].fail();
+		}
+	}
+	out.close();
+	if (!result)
+	{
+		removeParts();
+		return -1;
+	}
+
+	// Diff the partitions in parallel, each into its own change file.
+	std::vector<int64_t> changes(partitions, 0);
+	RunTasks(partitions, count, [&](const size_t p)
+	{
+		std::string oldName = TempFileName(output, tags[0], p);
+		std::string newName = TempFileName(output, tags[1], p);
+		{
+			CSV_ReadAhead oldPart(mReadAheadSize, mReadAheadDepth, INGEST_OPTION::INGEST_NONE, dCSVFileInfo.delimiter);
+			CSV_ReadAhead newPart(mReadAheadSize, mReadAheadDepth, INGEST_OPTION::INGEST_NONE, dCSVFileInfo.delimiter);
+			std::ofstream partOut(TempFileName(output, tags[2], p), std::ios::out | std::ios::trunc | std::ios::binary);
+			changes[p] = oldPart.Open(oldName) && newPart.Open(newName) && partOut.is_open() ?
+						DiffStreams(oldPart, newPart, keyColumns, dCSVFileInfo.delimiter, partOut) : -1;
+
+			// A full disk shows up as a failed stream.
+			partOut.close();
+			if (partOut.fail())
+			{
+				changes[p] = -1;
+			}
+		}
+		std::error_code removed;
+		std::filesystem::remove(oldName, removed);
+		std::filesystem::remove(newName, removed);
+	});
+
+	// Append the partition change files to the output.
+	int64_t total = 0;
+	for (size_t p = 0; p < partitions && total >= 0; p++)
+	{
+		if (changes[p] < 0 || !CopyFileBytes(TempFileName(output, tags[2], p), output, 0))
+		{
+			total = -1;
+			break;
+		}
+		total += changes[p];
+	}
+
+	removeParts();
+	return total;
+}
+
+int64_t CSV_Utility::Distinct(const std::string filename, const std::vector<int>& keyColumns, const std::string output, 
+							  const bool keepLast, const int threads)
+{
+	// Make sure the key columns are valid.
+	if (keyColumns.empty() || *std::min_element(keyColumns.begin(), keyColumns.end()) < 1)
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_INVALID_COLUMN, mUser, "Distinct", "", keyColumns.empty() ? 0 : *std::min_element(keyColumns.begin(), keyColumns.end()));
+		return -1;
+	}
+
+	// Writing over the input would truncate it before it is read.
+	std::error_code ec;
+	if (std::filesystem::equivalent(filename, output, ec))
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_OUTPUT_IS_INPUT, mUser, "Distinct", output, 0);
+		return -1;
+	}
+
+	// Read the column headers from row 1, the rows are read from the end of it.
+	CSV_ReadAhead header(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+	std::string_view line;
+	if (!header.Open(filename) || !header.GetLine(line))
+	{
+		return -1;
+	}
+	std::string columns(line);
+	std::streamoff bodyOffset = header.Offset();
+	header.Close();
+
+	std::ofstream out(output, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!out.is_open())
+	{
+		return -1;
+	}
+	out << columns << '\n';
+
+	// Most files have few enough keys to dedup in memory in one pass.
+	std::streamoff overflow = 0;
+	int64_t rows = DistinctRows(filename, bodyOffset, mIngest, keyColumns, keepLast, false, mMemoryBudget, out, overflow);
+	if (overflow == 0)
+	{
+		return rows;
+	}
+
+	// The keys didn't fit, start over with the file partitioned on the key.
+	CSV_LOG(CSV_LOG_INFO, EVENT_SPILLED_TO_DISK, mUser, "Distinct", TempFileName(output, "distinct.in", 0), mMemoryBudget);
+	out.close();
+	out.open(output, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!out.is_open())
+	{
+		return -1;
+	}
+	out << columns << '\n';
+
+	// The budget held the keys of the rows before the overflow, so each thread's share of it holds about that 
+	// many rows divided by the thread count.
+	uintmax_t size = std::filesystem::file_size(filename, ec);
+	size_t count = threads > 0 ? (size_t)threads : (size_t)std::thread::hardware_concurrency();
+	count = std::max<size_t>(1, count);
+	uintmax_t fitted = (uintmax_t)std::max<std::streamoff>(overflow - bodyOffset, 1);
+	size_t partitions = (size_t)((size - (uintmax_t)bodyOffset) * count / fitted) + 1;
+	if (partitions > 256)
+	{
+		partitions = 256;
+	}
+
+	// Lead each row with its row number, so the kept rows can be merged back into file order.
+	bool failed = false;
+	{
+		std::vector<std::ofstream> parts(partitions);
+		for (size_t p = 0; p < partitions; p++)
+		{
+			parts[p].open(TempFileName(output, "distinct.in", p), std::ios::out | std::ios::trunc | std::ios::binary);
+			failed = failed || !parts[p].is_open();
+		}
+
+		CSV_ReadAhead body(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+		failed = failed || !body.Open(filename, bodyOffset);
+		std::string key;
+		char number[24];
+		int64_t row = 0;
+		while (!failed && body.GetLine(line))
+		{
+			KeyOf(line, keyColumns, dCSVFileInfo.delimiter, key);
+			std::ofstream& part = parts[PartitionOf(key, partitions)];
+			char* end = std::to_chars(number, number + sizeof(number), row++).ptr;
+			part.write(number, end - number);
+			part.put(dCSVFileInfo.delimiter);
+			part.write(line.data(), (std::streamsize)line.size());
+			part.put('\n');
+		}
+
+		for (std::ofstream& part : parts)
+		{
+			part.close();
+			failed = failed || part.fail();
+		}
+	}
+
+	// Dedup the partitions in parallel, every row of a key is in the same partition.
+	std::vector<int64_t> kept(partitions, -1);
+	if (!failed)
+	{
+		RunTasks(partitions, count, [&](const size_t p)
+		{
+			std::string partName = TempFileName(output, "distinct.in", p);
+			std::ofstream partOut(TempFileName(output, "distinct.out", p), std::ios::out | std::ios::trunc | std::ios::binary);
+			std::streamoff unused = 0;
+			kept[p] = partOut.is_open() ? 
+					DistinctRows(partName, 0, INGEST_OPTION::INGEST_NONE, keyColumns, keepLast, true, 0, partOut, unused) : -1;
+		});
+	}
+
+	// Merge the kept rows of the partitions by row number, each partition is already in row order.
+	typedef std::pair<int64_t, size_t> Head;
+	std::priority_queue<Head, std::vector<Head>, std::greater<Head>> order;
+	std::vector<std::ifstream> parts(partitions);
+	std::vector<std::string> heads(partitions);
+	auto advance = [&](const size_t p)
+	{
+		int64_t row = 0;
+		if (ReadRecord(parts[p], heads[p], dCSVFileInfo.delimiter))
+		{
+			std::from_chars(heads[p].data(), heads[p].data() + heads[p].size(), row);
+			order.emplace(row, p);
+		}
+	};
+
+	int64_t total = 0;
+	for (size_t p = 0; p < partitions; p++)
+	{
+		total = total < 0 || kept[p] < 0 ? -1 : total + kept[p];
+		parts[p].open(TempFileName(output, "distinct.out", p), std::ios::in | std::ios::binary);
+	}
+	for (size_t p = 0; p < partitions && total >= 0; p++)
+	{
+		advance(p);
+	}
+
+	std::string buffer;
+	while (!order.empty())
+	{
+		size_t p = order.top().second;
+		order.pop();
+		buffer.append(heads[p], heads[p].find(dCSVFileInfo.delimiter) + 1);
+		buffer.push_back('\n');
+		if (buffer.size() >= 1024 * 1024)
+		{
+			out.write(buffer.data(), (std::streamsize)buffer.size());
+			buffer.clear();
+		}
+		advance(p);
+	}
+	out.write(buffer.data(), (std::streamsize)buffer.size());
+	out.close();
+	if (out.fail())
+	{
+		total = -1;
+	}
+
+	for (size_t p = 0; p < partitions; p++)
+	{
+		parts[p].close();
+		std::filesystem::remove(TempFileName(output, "distinct.in", p), ec);
+		std::filesystem::remove(TempFileName(output, "distinct.out", p), ec);
+	}
+
+	return total;
+}
+
+int64_t CSV_Utility::Profile(const std::string filename, CSVFileInfo& info, const int threads)
+{
+	// Read the column names from row 1, each column gets a profile.
+	CSV_ReadAhead header(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+	std::string_view line;
+	if (!header.Open(filename) || !header.GetLine(line))
+	{
+		return -1;
+	}
+	uint64_t bodyOffset = (uint64_t)header.Offset();
+	std::vector<std::string> names;
+	SplitLine(std::string(line), dCSVFileInfo.delimiter, names);
+	header.Close();
+
+	std::error_code ec;
+	uint64_t size = (uint64_t)std::filesystem::file_size(filename, ec);
+	if (ec)
+	{
+		return -1;
+	}
+
+	info = CSVFileInfo(filename, names, dCSVFileInfo.delimiter, 1, (int)names.size(), size);
+	for (const std::string& name : names)
+	{
+		info.profiles.push_back(CSVColumnProfile(name));
+	}
+
+	// Cut the body into ranges at row starts, more ranges than threads so a slow range doesn't hold up the rest.
+	size_t count = threads > 0 ? (size_t)threads : (size_t)std::thread::hardware_concurrency();
+	count = std::max<size_t>(1, count);
+	size_t ranges = count * 4;
+	std::vector<uint64_t> bounds;
+	if (!RowBounds(filename, bodyOffset, size, ranges, count, bounds))
+	{
+		return -1;
+	}
+
+	// Each range is profiled on its own and merged in when done, so only one set of sketches per thread is alive.
+	std::mutex lock;
+	std::atomic<bool> failed(false);
+	const char delimiter = dCSVFileInfo.delimiter;
+	RunTasks(ranges, count, [&](const size_t range)
+	{
+		if (bounds[range + 1] <= bounds[range])
+		{
+			return;
+		}
+
+		CSV_ReadAhead file(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+		if (!file.Open(filename, (std::streamoff)bounds[range]))
+		{
+			failed = true;
+			return;
+		}
+
+		std::vector<CSVColumnProfile> profiles(names.size());
+		int64_t rows = 0;
+		std::string_view row;
+		std::string unescaped;
+		while ((uint64_t)file.Offset() < bounds[range + 1] && file.GetLine(row))
+		{
+			rows++;
+			unescaped.clear();
+			size_t position = 0;
+			for (size_t column = 0; column < profiles.size(); column++)
+			{
+				if (position > row.size())
+				{
+					profiles[column].AddMissing();
+					continue;
+				}
+				profiles[column].Add(CSV_NextField(row, position, delimiter, unescaped));
+			}
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		for (size_t column = 0; column < profiles.size(); column++)
+		{
+			info.profiles[column].Merge(profiles[column]);
+		}
+		info.n_rows += rows;
+	});
+
+	if (failed)
+	{
+		return -1;
+	}
+
+	// Attach the profiles to this utility's file info too.
+	if (!dCSVFileInfo.filename.empty() && std::filesystem::equivalent(filename, dCSVFileInfo.filename, ec))
+	{
+		dCSVFileInfo.profiles = info.profiles;
+	}
+	return info.n_rows - 1;
+}
+
+bool CSV_Utility::IsEndOfFile()
+{
+	return mFile.eof();
+}
+
+bool CSV_Utility::GetFileInfo(CSVFileInfo& info)
+{
+	// Update info
+	UpdateFileInfo();
+
+	// If file info is valid, set the data
+	if (dCSVFileInfo.Valid())
+	{
+		info = dCSVFileInfo;
+
+		return true;
+	}
+
+	// Default return
+	return false;
+}
+
+bool CSV_Utility::GetFileInfo(std::string& filename, double size, int columns, int rows)
+{
+	// Update info
+	UpdateFileInfo();
+
+	// If file info is valid, set the data
+	if (dCSVFileInfo.Valid())
+	{
+		filename = dCSVFileInfo.filename;
+		size = (double)dCSVFileInfo.filesize;
+		columns = dCSVFileInfo.n_cols;
+		rows = (int)dCSVFileInfo.n_rows;
+
+		return true;
+	}
+
+	// Default return
+	return false;
+}
+
+bool CSV_Utility::GetFileInfo(std::string& filename, uint64_t& size, int& columns, int64_t& rows)
+{
+	// Update info
+	UpdateFileInfo();
+
+	// If file info is valid, set the data
+	if (dCSVFileInfo.Valid())
+	{
+		filename = dCSVFileInfo.filename;
+		size = dCSVFileInfo.filesize;
+		columns = dCSVFileInfo.n_cols;
+		rows = dCSVFileInfo.n_rows;
+
+		return true;
+	}
+
+	// Default return
+	return false;
+}
+
+bool CSV_Utility::ClearFile()
+{
+	// Close the file if open.
+	if (mFile.is_open())
+	{
+		mFile.close();
+	}
+	ClearRowIndex();
+
+	// While the filename isnt empty
+	if (!dCSVFileInfo.filename.empty())
+	{
+		// Open the file as output and truncating to clear all content - then re-close.
+		mFile.open(dCSVFileInfo.filename, UTILITY_MODE::WRITE_TRUNC);
+		mFile.close();
+
+		return true;
+	}
+
+	// Default return - Filename empty if here. 
+	return false;
+}
+
+size_t CSV_Utility::GetFileSize()
+{
+	uint64_t size = 0;
+	if (GetFileSize(size))
+	{
+		return (size_t)size;
+	}
+
+	// Default return
+	return -1;
+}
+
+bool CSV_Utility::GetFileSize(uint64_t& size)
+{
+	// Check if file is not open. 
+	if (!mFile.is_open())
+	{
+		return false;
+	}
+
+	if (mFile.good() || mFile.eof())
+	{
+		// Save current position and then go to top of file. 
+		auto curr_pos = mFile.tellg();
+
+		// Seek to end and get the size as a 64 bit offset
+		mFile.seekg(0, std::ios::end);
+		std::streamoff fsize = mFile.tellg();
+
+		// Return to position and return the size
+		mFile.seekp(curr_pos);
+		if (fsize < 0)
+		{
+			return false;
+		}
+
+		size = (uint64_t)fsize;
+		return true;
+	}
+	else
+	{
+		CatchFailReason();
+	}
+
+	// Default return
+	return false;
+}
+
+bool CSV_Utility::OpenFile()
+{
+	// Check if filename has been set.
+	if (dCSVFileInfo.filename.empty())
+	{
+		return false;
+	}
+
+	// Check if we are already opened. 
+	if (mFile.is_open())
+	{
+		return false;
+	}
+
+	// Verify outputFile is a valid file path / file name
+	size_t i = dCSVFileInfo.filename.rfind('/', dCSVFileInfo.filename.length());
+	if (i == std::string::npos)
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_INVALID_PATH, mUser, "OpenFile", dCSVFileInfo.filename, 0);
+		return false;
+	}
+	std::string directoryPath = dCSVFileInfo.filename.substr(0, i);
+
+	// Make the directory if it doesn't exist
+	struct stat st = { 0 };
+	if (stat(directoryPath.c_str(), &st) == -1)
+	{
+		int made = 0;
+#ifdef _WIN32
+		made = _mkdir(directoryPath.c_str());
+#else
+		made = mkdir(directoryPath.c_str(), 0777);
+#endif
+		if (made == -1)
+		{
+			CSV_LOG(CSV_LOG_ERROR, EVENT_DIRECTORY_FAILED, mUser, "OpenFile", directoryPath, errno);
+			return false;
+		}
+	}
+
+	// Check if outputFile has an extension, if not, add default extension.
+	if (!std::filesystem::path(dCSVFileInfo.filename).has_extension())
+	{
+		dCSVFileInfo.filename += mExtension;
+		CSV_LOG(CSV_LOG_INFO, EVENT_EXTENSION_ADDED, mUser, "OpenFile", dCSVFileInfo.filename, 0);
+	}
+
+	// open
+	mFile.open(dCSVFileInfo.filename, mMode);
+	if (!mFile.is_open())
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_FILE_OPEN_FAILED, mUser, "OpenFile", dCSVFileInfo.filename, 0);
+		return false;
+	}
+
+	if (mFile.good())
+	{
+		// Get file data. 
+		UpdateFileInfo();
+
+		// Success
+		CSV_LOG(CSV_LOG_INFO, EVENT_FILE_OPENED, mUser, "OpenFile", dCSVFileInfo.filename, 0);
+		return true;
+	}
+	else
+	{
+		CatchFailReason();
+	}
+	return false;
+}
+
+bool CSV_Utility::IsFileOpen()
+{
+	return mFile.is_open();
+}
+
+bool CSV_Utility::CloseFile()
+{
+	// Check if the file is open.
+	if (mFile.is_open())
+	{
+		// Apply any pending row updates.
+		if (!mPendingEdits.empty())
+		{
+			Flush();
+		}
+
+		// Make the last rows durable if a durability policy is set.
+		if (mDurability != DURABILITY_MODE::DURABILITY_NONE && mMode != UTILITY_MODE::READ)
+		{
+			SyncRows();
+		}
+
+		// Wait out any fsync in progress, then close the file, clear the filename and reset the file flag
+		{
+			std::unique_lock<std::mutex> sync(mSyncLock);
+			mSyncSignal.wait(sync, [this] { return !mSyncing; });
+			std::lock_guard<std::mutex> lock(mWriteLock);
+			CloseSyncHandle();
+			ClearRowIndex();
+			mFile.close();
+			mSyncedTicket = mWriteTicket;
+			mUnsyncedRows = 0;
+		}
+		dCSVFileInfo.filename = "";
+
+		// Verify file is closed and return appropriately. 
 		if (mFile.is_open())
 		{
 			return false;
@@ -811,38 +2968,1680 @@ bool CSV_Utility::CloseFile()
 		return true;
 	}
 
-	// Default retun
-	return false;
+	// Default retun
+	return false;
+}
+
+void CSV_Utility::CatchFailReason()
+{
+	// The sink turns the state bits into eof / bad / fail / unknown.
+	CSV_LOG(CSV_LOG_ERROR, EVENT_STREAM_FAILED, mUser, "CatchFailReason", dCSVFileInfo.filename, mFile.rdstate());
+}
+
+void CSV_Utility::UpdateFileInfo()
+{
+	if (!dCSVFileInfo.filename.empty())
+	{
+		dCSVFileInfo.col_names.clear();
+		GetColumnHeaders(dCSVFileInfo.col_names);
+		dCSVFileInfo.n_cols = GetNumberOfColumns();
+		dCSVFileInfo.n_rows = -1;
+		GetNumberOfRows(dCSVFileInfo.n_rows);
+		dCSVFileInfo.filesize = 0;
+		GetFileSize(dCSVFileInfo.filesize);
+	}
+}
+
+int CSV_Utility::SplitLine(std::string_view line, const char delimiter, std::vector<std::string>& values)
+{
+	values.clear();
+
+	// Walk the line, cutting a field at every delimiter outside quotes. Empty fields are kept. 
+	std::string unescaped;
+	size_t position = 0;
+	while (position <= line.size())
+	{
+		values.emplace_back(CSV_NextField(line, position, delimiter, unescaped));
+	}
+
+	return (int)values.size();
+}
+
+int64_t CSV_Utility::DistinctRows(const std::string& filename, const std::streamoff offset, const int ingest, 
+								  const std::vector<int>& keyColumns, const bool keepLast, const bool numbered, 
+								  const size_t budget, std::ostream& out, std::streamoff& overflow)
+{
+	overflow = 0;
+	CSV_ReadAhead rows(mReadAheadSize, mReadAheadDepth, ingest, dCSVFileInfo.delimiter);
+	if (!rows.Open(filename, offset))
+	{
+		return -1;
+	}
+
+	CSV_KeySet keys;
+	std::string_view line;
+	std::string key;
+	int64_t position = 0;
+
+	// Get the row of the next line and its key, a partitioned row's number is stripped from the key.
+	auto next = [&](int64_t& row) -> bool
+	{
+		if (!rows.GetLine(line))
+		{
+			return false;
+		}
+		std::string_view body = line;
+		row = position++;
+		if (numbered)
+		{
+			size_t split = body.find(dCSVFileInfo.delimiter);
+			split = split == std::string_view::npos ? 0 : split;
+			std::from_chars(body.data(), body.data() + split, row);
+			body.remove_prefix(split + 1);
+		}
+		KeyOf(body, keyColumns, dCSVFileInfo.delimiter, key);
+		return true;
+	};
+
+	// Keys are only stored once, so the set only grows on a new key.
+	auto overBudget = [&]()
+	{
+		if (budget > 0 && keys.Memory() > budget)
+		{
+			overflow = std::max<std::streamoff>(rows.Offset(), 1);
+			return true;
+		}
+		return false;
+	};
+
+	int64_t kept = 0;
+	std::string buffer;
+	auto emit = [&]()
+	{
+		buffer.append(line.data(), line.size());
+		buffer.push_back('\n');
+		kept++;
+		if (buffer.size() >= 1024 * 1024)
+		{
+			out.write(buffer.data(), (std::streamsize)buffer.size());
+			buffer.clear();
+		}
+	};
+
+	int64_t row = 0;
+	if (!keepLast)
+	{
+		// The first row of a key is the one that adds it.
+		while (next(row))
+		{
+			if (keys.Insert(key, HashBytes(key), row))
+			{
+				if (overBudget())
+				{
+					return -1;
+				}
+				emit();
+			}
+		}
+	}
+	else
+	{
+		// Find the last row of every key, then keep the rows that are.
+		while (next(row))
+		{
+			size_t size = keys.Size();
+			keys.Assign(key, HashBytes(key), row);
+			if (keys.Size() != size && overBudget())
+			{
+				return -1;
+			}
+		}
+
+		rows.Close();
+		if (!rows.Open(filename, offset))
+		{
+			return -1;
+		}
+		position = 0;
+		while (next(row))
+		{
+			if (keys.Find(key, HashBytes(key)) == row)
+			{
+				emit();
+			}
+		}
+	}
+
+	out.write(buffer.data(), (std::streamsize)buffer.size());
+	out.flush();
+	return out.good() ? kept : -1;
+}
+
+size_t CSV_Utility::PartitionOf(const std::string& key, const size_t partitions, const uint64_t seed)
+{
+	uint64_t hash = HashBytes(key);
+	if (seed != 0)
+	{
+		// Mix the seed in, keys that shared a partition at one level spread over the next.
+		hash ^= seed * 0x9E3779B97F4A7C15ULL;
+		hash ^= hash >> 33;
+		hash *= 0xFF51AFD7ED558CCDULL;
+		hash ^= hash >> 33;
+	}
+	return (size_t)(hash % partitions);
+}
+
+std::string CSV_Utility::TempFileName(const std::string& base, const std::string& tag, const size_t index)
+{
+	return base + "." + tag + "." + std::to_string(index) + ".tmp";
+}
+
+int CSV_Utility::RowWritten(const int count, std::unique_lock<std::mutex>& lock, const int64_t rows)
+{
+	// Increment the number of rows and take a ticket for the rows. The row index and cache no longer match the file.
+	dCSVFileInfo.n_rows += rows;
+	if (!mRowIndex.empty())
+	{
+		ClearRowIndex();
+	}
+	mRowCache.Clear();
+	mWriteTicket += (uint64_t)rows;
+	mUnsyncedRows += rows;
+	bool sync = mDurability == DURABILITY_MODE::DURABILITY_ROWS && mUnsyncedRows >= mDurabilityValue;
+	lock.unlock();
+
+	// Sync outside the write lock so other writers keep going and can share the fsync.
+	if (sync && !SyncRows())
+	{
+		return -1;
+	}
+
+	return count;
+}
+
+bool CSV_Utility::WriteRowBatches(const std::vector<std::vector<std::string>>& values, const size_t threads)
+{
+	// Buffers live in the slots for the whole call so they stop allocating once they have grown to a batch.
+	const size_t slots = threads * 2;
+	std::vector<std::string> buffers(slots);
+	std::vector<size_t> firsts(slots);
+	const char delimiter = dCSVFileInfo.delimiter;
+	const int quote = mQuote;
+	const size_t rows = values.size();
+
+	// Under DURABILITY_ROWS a batch is no bigger than the sync interval, so the file is synced every N rows.
+	size_t batchRows = CSV_WRITE_BATCH_ROWS;
+	if (mDurability == DURABILITY_MODE::DURABILITY_ROWS && mDurabilityValue > 0)
+	{
+		batchRows = std::min<size_t>(batchRows, (size_t)mDurabilityValue);
+	}
+
+	// Workers format batches while this thread writes the finished ones.
+	CSV_BatchWorkers workers(threads, slots, [&](const size_t slot)
+	{
+		std::string& buffer = buffers[slot];
+		buffer.clear();
+		size_t end = std::min(rows, firsts[slot] + batchRows);
+		for (size_t row = firsts[slot]; row < end; row++)
+		{
+			for (size_t i = 0; i < values[row].size(); i++)
+			{
+				if (i != 0)
+				{
+					buffer.push_back(delimiter);
+				}
+				size_t start = buffer.size();
+				buffer.append(values[row][i]);
+				CSV_QuoteField(buffer, start, delimiter, quote);
+			}
+			buffer.push_back('\n');
+		}
+	});
+
+	// Write a finished batch and count its rows, so the durability policy sees every batch.
+	bool result = true;
+	auto drain = [&](const size_t slot)
+	{
+		if (!result)
+		{
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(mWriteLock);
+		mFile.write(buffers[slot].data(), (std::streamsize)buffers[slot].size());
+		if (!mFile.good())
+		{
+			CatchFailReason();
+			result = false;
+			return;
+		}
+		if (RowWritten(0, lock, (int64_t)(std::min(rows, firsts[slot] + batchRows) - firsts[slot])) < 0)
+		{
+			result = false;
+		}
+	};
+
+	size_t slot = 0;
+	for (size_t first = 0; first < rows && result; first += batchRows)
+	{
+		// Batches come back in row order, write any that are done, or wait for the oldest when every slot is busy.
+		while (workers.Take(slot, workers.Full()))
+		{
+			drain(slot);
+		}
+		firsts[workers.Free()] = first;
+		workers.Submit();
+	}
+	while (workers.Take(slot, true))
+	{
+		drain(slot);
+	}
+
+	return result;
+}
+
+bool CSV_Utility::SyncRows()
+{
+	// The last row this call has to make durable.
+	uint64_t ticket = 0;
+	{
+		std::lock_guard<std::mutex> lock(mWriteLock);
+		ticket = mWriteTicket;
+	}
+
+	std::unique_lock<std::mutex> sync(mSyncLock);
+	while (mSyncedTicket < ticket)
+	{
+		// Someone else is syncing, their fsync may cover our rows too.
+		if (mSyncing)
+		{
+			mSyncSignal.wait(sync);
+			continue;
+		}
+
+		// Lead the next fsync for every row written up to now.
+		mSyncing = true;
+		sync.unlock();
+
+		bool result = true;
+		uint64_t target = 0;
+		int handle = -1;
+		{
+			std::lock_guard<std::mutex> lock(mWriteLock);
+			target = mWriteTicket;
+			mUnsyncedRows = 0;
+			if (mFile.is_open())
+			{
+				mFile.flush();
+				result = !mFile.bad();
+				if (mSyncHandle < 0)
+				{
+#ifdef _WIN32
+					mSyncHandle = _open(dCSVFileInfo.filename.c_str(), _O_WRONLY);
+#else
+					mSyncHandle = open(dCSVFileInfo.filename.c_str(), O_WRONLY);
+#endif
+				}
+				handle = mSyncHandle;
+				result = result && handle >= 0;
+			}
+		}
+
+		// The fsync itself runs without the write lock held.
+		if (result && handle >= 0)
+		{
+#ifdef _WIN32
+			result = _commit(handle) == 0;
+#else
+			result = fsync(handle) == 0;
+#endif
+		}
+
+		sync.lock();
+		mSyncing = false;
+		if (result && target > mSyncedTicket)
+		{
+			mSyncedTicket = target;
+		}
+		mSyncSignal.notify_all();
+
+		if (!result)
+		{
+			CSV_LOG(CSV_LOG_ERROR, EVENT_SYNC_FAILED, mUser, "SyncRows", dCSVFileInfo.filename, 0);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void CSV_Utility::DurabilityThread()
+{
+	std::unique_lock<std::mutex> sync(mSyncLock);
+	while (!mDurabilityStop)
+	{
+		// Sleep for the interval, new rows are synced as one group.
+		mSyncSignal.wait_for(sync, std::chrono::milliseconds(mDurabilityValue), [this] { return mDurabilityStop; });
+		if (mDurabilityStop)
+		{
+			break;
+		}
+
+		sync.unlock();
+		SyncRows();
+		sync.lock();
+	}
+}
+
+void CSV_Utility::StopDurabilityThread()
+{
+	{
+		std::lock_guard<std::mutex> sync(mSyncLock);
+		mDurabilityStop = true;
+	}
+	mSyncSignal.notify_all();
+
+	if (mDurabilityThread.joinable())
+	{
+		mDurabilityThread.join();
+	}
+}
+
+void CSV_Utility::CloseSyncHandle()
+{
+	if (mSyncHandle >= 0)
+	{
+#ifdef _WIN32
+		_close(mSyncHandle);
+#else
+		close(mSyncHandle);
+#endif
+		mSyncHandle = -1;
+	}
+}
+
+bool CSV_Utility::SyncPath(const std::string& path)
+{
+#ifdef _WIN32
+	// NTFS journals directory changes itself, there is no directory handle to flush.
+	if (std::filesystem::is_directory(path))
+	{
+		return true;
+	}
+
+	int handle = _open(path.c_str(), _O_WRONLY);
+	if (handle < 0)
+	{
+		return false;
+	}
+
+	bool result = _commit(handle) == 0;
+	_close(handle);
+	return result;
+#else
+	int handle = open(path.c_str(), O_RDONLY);
+	if (handle < 0)
+	{
+		return false;
+	}
+
+	bool result = fsync(handle) == 0;
+	close(handle);
+	return result;
+#endif
+}
+
+int CSV_Utility::CompareValues(const std::string& value, const std::string& bound, const bool numeric)
+{
+	double a = 0, b = 0;
+	if (numeric && CSV_Field<double>::Parse(value, a) && CSV_Field<double>::Parse(bound, b))
+	{
+		return a < b ? -1 : (a > b ? 1 : 0);
+	}
+
+	return value.compare(bound);
+}
+
+void CSV_Utility::ClearRowIndex()
+{
+	mRowIndex.clear();
+	mZoneMaps = false;
+	mRowCache.Clear();
+}
+
+void CSV_Utility::SeekToRow(std::istream& stream, const int64_t row)
+{
+	// Start from the nearest indexed block, or the top of file. 
+	int64_t i = 1;
+	std::streamoff start = 0;
+	if (!mRowIndex.empty())
+	{
+		size_t block = (size_t)((row - 1) / mBlockRows);
+		if (block < mRowIndex.size())
+		{
+			i = mRowIndex[block].first_row;
+			start = mRowIndex[block].offset;
+		}
+	}
+	stream.clear();
+	stream.seekg(start, std::ios::beg);
+
+	// Skip to the row, a row with a quoted newline spans several lines.
+	std::string skipped;
+	for (; i < row && ReadRecord(stream, skipped, dCSVFileInfo.delimiter); i++)
+	{
+	}
+}
+
+std::mt19937_64 CSV_Utility::SampleGenerator(const uint64_t seed)
+{
+	if (seed != 0)
+	{
+		return std::mt19937_64(seed);
+	}
+
+	std::random_device device;
+	return std::mt19937_64(((uint64_t)device() << 32) | device());
+}
+
+bool CSV_Utility::UpdateRowData(const int64_t row, const int column, const std::vector<std::string>& values)
+{
+	std::lock_guard<std::mutex> lock(mWriteLock);
+
+	// Make sure file is open and we are in a write mode
+	if (!mFile.is_open() || (mMode != UTILITY_MODE::WRITE_APPEND && mMode != UTILITY_MODE::WRITE_TRUNC &&
+							mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+	{
+		return false;
+	}
+
+	if (row < 1 || values.empty())
+	{
+		return false;
+	}
+
+	// Patch through a second stream, the utility's stream may be in append mode.
+	mFile.flush();
+	std::fstream patch(dCSVFileInfo.filename, std::ios::in | std::ios::out | std::ios::binary);
+	if (!patch.is_open())
+	{
+		return false;
+	}
+
+	// Find the row and its current contents.
+	SeekToRow(patch, row);
+	std::streamoff offset = patch.tellg();
+	std::string old;
+	if (offset < 0 || !ReadRecord(patch, old, dCSVFileInfo.delimiter))
+	{
+		return false;
+	}
+	if (!old.empty() && old.back() == '\r')
+	{
+		old.pop_back();
+	}
+
+	// Build the new row on top of a pending edit of the same row if there is one.
+	auto pending = mPendingEdits.find(row);
+	std::string updated;
+	if (column == 0)
+	{
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			if (i != 0)
+			{
+				updated.push_back(dCSVFileInfo.delimiter);
+			}
+			size_t start = updated.size();
+			updated += values[i];
+			CSV_QuoteField(updated, start, dCSVFileInfo.delimiter, mQuote);
+		}
+	}
+	else
+	{
+		std::vector<std::string> fields;
+		SplitLine(pending != mPendingEdits.end() ? pending->second : old, dCSVFileInfo.delimiter, fields);
+		if ((size_t)column > fields.size())
+		{
+			fields.resize(column);
+		}
+		fields[column - 1] = values[0];
+
+		for (size_t i = 0; i < fields.size(); i++)
+		{
+			if (i != 0)
+			{
+				updated.push_back(dCSVFileInfo.delimiter);
+			}
+			size_t start = updated.size();
+			updated += fields[i];
+			CSV_QuoteField(updated, start, dCSVFileInfo.delimiter, mQuote);
+		}
+	}
+
+	// Same length as the old row, overwrite in place. Padding a shorter row would change its values.
+	if (pending == mPendingEdits.end() && updated.size() == old.size())
+	{
+		patch.clear();
+		patch.seekp(offset, std::ios::beg);
+		patch.write(updated.data(), (std::streamsize)updated.size());
+		patch.flush();
+
+		// Row offsets still hold, the zone maps and cached rows may not.
+		if (mZoneMaps)
+		{
+			ClearRowIndex();
+		}
+		mRowCache.Clear();
+		return patch.good();
+	}
+
+	// Otherwise hold it for the rewrite on Flush or CloseFile.
+	mPendingEdits[row] = updated;
+	return true;
+}
+
+bool CSV_Utility::RewriteHeader(const std::vector<std::string>& names, const bool replace)
+{
+	// Make sure file is open and we are in a write mode
+	if (!mFile.is_open() || (mMode != UTILITY_MODE::WRITE_APPEND && mMode != UTILITY_MODE::WRITE_TRUNC &&
+							mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+	{
+		return false;
+	}
+
+	// Pending row updates are numbered against the current rows, apply them first.
+	if (!Flush())
+	{
+		return false;
+	}
+
+	// Nothing to insert in front of, the header is just the first row.
+	std::string filename = dCSVFileInfo.filename;
+	std::error_code ec;
+	uint64_t size = std::filesystem::file_size(filename, ec);
+	if (ec)
+	{
+		return false;
+	}
+	if (size == 0)
+	{
+		return WriteRow(names) >= 0;
+	}
+
+	std::string header;
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (i != 0)
+		{
+			header.push_back(dCSVFileInfo.delimiter);
+		}
+		size_t start = header.size();
+		header += names[i];
+		CSV_QuoteField(header, start, dCSVFileInfo.delimiter, mQuote);
+	}
+
+	// Wait out any fsync in progress before the file may be swapped.
+	std::unique_lock<std::mutex> sync(mSyncLock);
+	mSyncSignal.wait(sync, [this] { return !mSyncing; });
+	std::lock_guard<std::mutex> lock(mWriteLock);
+
+	// Find the span of the old header, the body starts after it.
+	uint64_t bodyOffset = 0;
+	bool cr = false;
+	if (replace)
+	{
+		std::ifstream in(filename, std::ios::in | std::ios::binary);
+		std::string old;
+		ReadRecord(in, old, dCSVFileInfo.delimiter);
+		bodyOffset = in.eof() ? size : (uint64_t)old.size() + 1;
+		cr = !old.empty() && old.back() == '\r';
+		if (cr)
+		{
+			old.pop_back();
+		}
+
+		// Same length as the old header, patch in place. Padding a shorter header would change its names.
+		if (header.size() == old.size())
+		{
+			std::fstream patch(filename, std::ios::in | std::ios::out | std::ios::binary);
+			patch.seekp(0, std::ios::beg);
+			patch.write(header.data(), (std::streamsize)header.size());
+			patch.flush();
+			ClearRowIndex();
+			return patch.good();
+		}
+	}
+
+	// Write the header to a temporary, then have the kernel copy the body behind it.
+	std::string temp = TempFileName(filename, "header", 0);
+	{
+		std::ofstream out(temp, std::ios::out | std::ios::trunc | std::ios::binary);
+		out << header;
+		if (cr)
+		{
+			out << '\r';
+		}
+		out << '\n';
+		out.close();
+		if (out.fail())
+		{
+			std::filesystem::remove(temp, ec);
+			return false;
+		}
+	}
+
+	if (!CopyFileBytes(filename, temp, bodyOffset) || !SyncPath(temp))
+	{
+		std::filesystem::remove(temp, ec);
+		return false;
+	}
+
+	if (!SwapInFile(temp))
+	{
+		return false;
+	}
+
+	if (!replace)
+	{
+		dCSVFileInfo.n_rows++;
+	}
+	return true;
+}
+
+bool CSV_Utility::SwapInFile(const std::string& temp)
+{
+	// Close the file and rename the temporary over it.
+	std::string filename = dCSVFileInfo.filename;
+	std::error_code ec;
+	CloseSyncHandle();
+	mFile.close();
+	std::filesystem::rename(temp, filename, ec);
+	ClearRowIndex();
+
+	// Reopen without truncating, positioned at the end for further writes.
+	std::ios::openmode reopen = static_cast<std::ios::openmode>(mMode);
+	if (reopen & std::ios::trunc)
+	{
+		reopen = (reopen & ~std::ios::trunc) | std::ios::in | std::ios::out;
+	}
+	mFile.open(filename, reopen);
+	mFile.seekp(0, std::ios::end);
+
+	if (ec)
+	{
+		std::filesystem::remove(temp, ec);
+		return false;
+	}
+
+	// Make the rename durable.
+	std::string directory = std::filesystem::path(filename).parent_path().string();
+	SyncPath(directory.empty() ? "." : directory);
+	return mFile.is_open();
+}
+
+bool CSV_Utility::CopyFileBytes(const std::string& source, const std::string& destination, const uint64_t offset, const uint64_t bytes)
+{
+	std::error_code ec;
+	uint64_t size = std::filesystem::file_size(source, ec);
+	if (ec || offset > size)
+	{
+		return false;
+	}
+	uint64_t copied = 0;
+	uint64_t length = std::min(size - offset, bytes);
+
+#if defined(__linux__)
+	// Let the kernel move the bytes, copy_file_range first, then sendfile.
+	int in = open(source.c_str(), O_RDONLY);
+	int out = open(destination.c_str(), O_WRONLY);
+	if (in >= 0 && out >= 0 && lseek(out, 0, SEEK_END) >= 0)
+	{
+		loff_t from = (loff_t)offset;
+		while (copied < length)
+		{
+			ssize_t n = copy_file_range(in, &from, out, NULL, (size_t)(length - copied), 0);
+			if (n <= 0)
+			{
+				break;
+			}
+			copied += (uint64_t)n;
+		}
+
+		off_t position = (off_t)(offset + copied);
+		while (copied < length)
+		{
+			ssize_t n = sendfile(out, in, &position, (size_t)(length - copied));
+			if (n <= 0)
+			{
+				break;
+			}
+			copied += (uint64_t)n;
+		}
+	}
+	if (in >= 0)
+	{
+		close(in);
+	}
+	if (out >= 0)
+	{
+		close(out);
+	}
+#endif
+
+	// Anything left goes through a buffered copy.
+	if (copied < length)
+	{
+		std::ifstream in(source, std::ios::in | std::ios::binary);
+		std::ofstream out(destination, std::ios::out | std::ios::app | std::ios::binary);
+		in.seekg((std::streamoff)(offset + copied), std::ios::beg);
+		std::vector<char> buffer(mReadAheadSize);
+		while (copied < length && in.good())
+		{
+			size_t chunk = (size_t)std::min<uint64_t>(buffer.size(), length - copied);
+			in.read(buffer.data(), (std::streamsize)chunk);
+			std::streamsize n = in.gcount();
+			if (n <= 0)
+			{
+				break;
+			}
+			out.write(buffer.data(), n);
+			copied += (uint64_t)n;
+		}
+		out.flush();
+		if (!out.good())
+		{
+			return false;
+		}
+	}
+
+	return copied == length;
+}
+
+void CSV_Utility::AppendRenderedRow(std::string& buffer, const std::string& label, const size_t labelWidth, 
+									const std::vector<std::string>& fields, const std::vector<size_t>& widths, const size_t maxWidth)
+{
+	buffer += label;
+	buffer.append(labelWidth > label.size() ? labelWidth - label.size() : 1, ' ');
+
+	for (size_t c = 0; c < fields.size(); c++)
+	{
+		const std::string& field = fields[c];
+		size_t width = c < widths.size() ? widths[c] : std::min(field.size(), maxWidth);
+
+		// Cut values wider than the column, marking the cut with '~'.
+		if (field.size() > width)
+		{
+			buffer.append(field, 0, width - 1);
+			buffer.push_back('~');
+		}
+		else
+		{
+			buffer += field;
+			if (c + 1 < fields.size())
+			{
+				buffer.append(width - field.size(), ' ');
+			}
+		}
+
+		if (c + 1 < fields.size())
+		{
+			buffer.append("  ");
+		}
+	}
+	buffer.push_back('\n');
+}
+
+bool CSV_Utility::ReadTailLines(const std::string& filename, const int64_t count, const int ingest, std::vector<std::string>& lines)
+{
+	std::ifstream in(filename, std::ios::in | std::ios::binary);
+	if (!in.is_open())
+	{
+		return false;
+	}
+
+	in.seekg(0, std::ios::end);
+	std::streamoff size = in.tellg();
+	if (size <= 0)
+	{
+		return size == 0;
+	}
+
+	// Walk back from the end a block at a time until enough line breaks are found.
+	const std::streamoff block = 64 * 1024;
+	std::string tail;
+	std::streamoff position = size;
+	int64_t breaks = 0;
+	while (position > 0 && breaks <= count)
+	{
+		std::streamoff start = position > block ? position - block : 0;
+		std::string chunk((size_t)(position - start), '\0');
+		in.seekg(start, std::ios::beg);
+		in.read(&chunk[0], (std::streamsize)chunk.size());
+		for (size_t i = 0; i < chunk.size(); i++)
+		{
+			// The newline ending the last line does not start another one.
+			if (chunk[i] == '\n' && start + (std::streamoff)i != size - 1)
+			{
+				breaks++;
+			}
+		}
+		tail.insert(0, chunk);
+		position = start;
+	}
+
+	// Split what was read and keep the last count lines.
+	std::vector<std::string> all;
+	size_t begin = 0;
+	while (begin < tail.size())
+	{
+		size_t end = tail.find('\n', begin);
+		if (end == std::string::npos)
+		{
+			end = tail.size();
+		}
+		std::string_view text(tail.data() + begin, end - begin);
+		CSV_ReadAhead::Normalize(text, position == 0 && begin == 0, ingest);
+		all.emplace_back(text);
+		begin = end + 1;
+	}
+
+	// The first piece is partial unless the walk reached the top of the file.
+	size_t first = all.size() > (size_t)count ? all.size() - (size_t)count : 0;
+	if (first == 0 && position > 0 && !all.empty())
+	{
+		first = 1;
+	}
+	lines.assign(all.begin() + first, all.end());
+	return true;
+}
+
+int CSV_Utility::CountFields(const std::string& line, const char delimiter)
+{
+	int fields = 1;
+	bool quoted = false;
+	for (char c : line)
+	{
+		if (c == '"')
+		{
+			quoted = !quoted;
+		}
+		else if (c == delimiter && !quoted)
+		{
+			fields++;
+		}
+	}
+	return fields;
+}
+
+int64_t CSV_Utility::ValidateChunk(const std::string& filename, const uint64_t start, const uint64_t end, const char delimiter,
+								   const int columns, const int64_t maxErrors, std::vector<CSVViolation>& violations)
+{
+	std::ifstream in(filename, std::ios::in | std::ios::binary);
+	if (!in.is_open())
+	{
+		return -1;
+	}
+
+	// The chunk starts on a row, outside any quoted field.
+	uint64_t base = start;
+	std::vector<char> buffer((size_t)(end - base));
+	in.seekg((std::streamoff)base, std::ios::beg);
+	in.read(buffer.data(), (std::streamsize)buffer.size());
+	buffer.resize((size_t)in.gcount());
+	size_t i = 0;
+	if (base >= end)
+	{
+		return 0;
+	}
+
+	int64_t rows = 0;
+	uint64_t rowStart = base + i;
+	uint64_t quoteStart = 0;
+	uint64_t utf8Start = 0;
+	int fields = 1;
+	bool quoted = false;
+	bool inRow = false;
+	bool cr = false;
+	int need = 0;
+	unsigned char low = 0x80;
+	unsigned char high = 0xBF;
+
+	// Bytes that end a row or change its state, everything else is skipped in a tight loop.
+	bool special[256] = {};
+	special[(unsigned char)'\n'] = true;
+	special[(unsigned char)'\r'] = true;
+	special[(unsigned char)'"'] = true;
+	special[(unsigned char)delimiter] = true;
+	for (int b = 0x80; b < 256; b++)
+	{
+		special[b] = true;
+	}
+
+	auto report = [&](const uint64_t offset, const VIOLATION_TYPE type, const int count)
+	{
+		violations.push_back(CSVViolation(rows + 1, offset, type, count));
+		return maxErrors > 0 && (int64_t)violations.size() >= maxErrors;
+	};
+
+	while (true)
+	{
+		// Keep reading past the end of the chunk to finish the last row.
+		if (i >= buffer.size())
+		{
+			if (!in.good())
+			{
+				break;
+			}
+			base += buffer.size();
+			buffer.resize(64 * 1024);
+			in.read(buffer.data(), (std::streamsize)buffer.size());
+			buffer.resize((size_t)in.gcount());
+			i = 0;
+			if (buffer.empty())
+			{
+				break;
+			}
+		}
+
+		if (need == 0 && !cr)
+		{
+			size_t plain = i;
+			while (i < buffer.size() && !special[(unsigned char)buffer[i]])
+			{
+				i++;
+			}
+			if (i > plain)
+			{
+				inRow = true;
+				continue;
+			}
+		}
+
+		unsigned char c = (unsigned char)buffer[i];
+		uint64_t offset = base + i;
+		i++;
+		inRow = true;
+
+		// Continuation bytes of a multi byte UTF-8 sequence.
+		if (need > 0)
+		{
+			if (c >= low && c <= high)
+			{
+				need--;
+				low = 0x80;
+				high = 0xBF;
+				continue;
+			}
+
+			// Broken sequence, this byte is checked again as the start of a new one.
+			need = 0;
+			low = 0x80;
+			high = 0xBF;
+			if (report(utf8Start, VIOLATION_INVALID_UTF8, 0))
+			{
+				return rows + 1;
+			}
+		}
+
+		if (cr && c != '\n' && !quoted)
+		{
+			if (report(offset - 1, VIOLATION_STRAY_CR, 0))
+			{
+				return rows + 1;
+			}
+		}
+		cr = false;
+
+		if (c < 0x80)
+		{
+			if (c == '\n' && quoted)
+			{
+				// A quoted field holding a newline, the row goes on.
+			}
+			else if (c == '\n')
+			{
+				// End of the row.
+				bool stop = false;
+				if (fields != columns)
+				{
+					stop = report(rowStart, VIOLATION_COLUMN_COUNT, fields);
+				}
+				rows++;
+				if (stop)
+				{
+					return rows;
+				}
+
+				fields = 1;
+				quoted = false;
+				inRow = false;
+				rowStart = offset + 1;
+				if (rowStart >= end)
+				{
+					return rows;
+				}
+			}
+			else if (c == '\r')
+			{
+				cr = true;
+			}
+			else if (c == '"')
+			{
+				quoted = !quoted;
+				quoteStart = offset;
+			}
+			else if (c == (unsigned char)delimiter && !quoted)
+			{
+				fields++;
+			}
+			continue;
+		}
+
+		// Lead byte of a multi byte sequence, rejecting overlong forms, surrogates and values past U+10FFFF.
+		utf8Start = offset;
+		if (c >= 0xC2 && c <= 0xDF)
+		{
+			need = 1;
+		}
+		else if (c >= 0xE0 && c <= 0xEF)
+		{
+			need = 2;
+			low = c == 0xE0 ? 0xA0 : 0x80;
+			high = c == 0xED ? 0x9F : 0xBF;
+		}
+		else if (c >= 0xF0 && c <= 0xF4)
+		{
+			need = 3;
+			low = c == 0xF0 ? 0x90 : 0x80;
+			high = c == 0xF4 ? 0x8F : 0xBF;
+		}
+		else if (report(offset, VIOLATION_INVALID_UTF8, 0))
+		{
+			return rows + 1;
+		}
+	}
+
+	// A final row without a newline.
+	if (need > 0)
+	{
+		report(utf8Start, VIOLATION_INVALID_UTF8, 0);
+	}
+	if (cr)
+	{
+		report(base + i - 1, VIOLATION_STRAY_CR, 0);
+	}
+	if (inRow)
+	{
+		if (quoted)
+		{
+			report(quoteStart, VIOLATION_UNBALANCED_QUOTE, 0);
+		}
+		else if (fields != columns)
+		{
+			report(rowStart, VIOLATION_COLUMN_COUNT, fields);
+		}
+		rows++;
+	}
+	return rows;
+}
+
+std::string CSV_Utility::ShardFileName(const std::string& filename, const size_t index)
+{
+	std::filesystem::path path(filename);
+	std::filesystem::path shard = path.parent_path() / (path.stem().string() + "_" + std::to_string(index + 1) + path.extension().string());
+	return shard.string();
+}
+
+bool CSV_Utility::RowBounds(const std::string& filename, const uint64_t bodyOffset, const uint64_t size, const size_t ranges, 
+							const size_t threads, std::vector<uint64_t>& bounds)
+{
+	// Equal byte cuts, then the number of quotes between each pair of cuts.
+	std::vector<uint64_t> cuts(ranges + 1);
+	for (size_t i = 0; i <= ranges; i++)
+	{
+		cuts[i] = bodyOffset + (size - bodyOffset) * i / ranges;
+	}
+	std::vector<uint64_t> quotes(ranges, 0);
+	std::atomic<bool> failed(false);
+	RunTasks(ranges, threads, [&](const size_t i)
+	{
+		std::ifstream in(filename, std::ios::in | std::ios::binary);
+		in.seekg((std::streamoff)cuts[i], std::ios::beg);
+		char buffer[64 * 1024];
+		uint64_t remaining = cuts[i + 1] - cuts[i];
+		while (remaining > 0 && in.good())
+		{
+			in.read(buffer, (std::streamsize)std::min<uint64_t>(remaining, sizeof(buffer)));
+			size_t n = (size_t)in.gcount();
+			quotes[i] += (uint64_t)std::count(buffer, buffer + n, '"');
+			remaining -= n;
+		}
+		if (remaining > 0)
+		{
+			failed = true;
+		}
+	});
+	if (failed)
+	{
+		return false;
+	}
+
+	// An odd number of quotes before a cut puts it inside a quoted field. A row starts right after a 
+	// newline outside quotes, looking from the byte before the cut.
+	bounds.assign(1, bodyOffset);
+	uint64_t before = 0;
+	std::ifstream in(filename, std::ios::in | std::ios::binary);
+	for (size_t i = 1; i < ranges; i++)
+	{
+		before += quotes[i - 1];
+		if (cuts[i] <= bodyOffset)
+		{
+			bounds.push_back(bodyOffset);
+			continue;
+		}
+		bool quoted = (before & 1) != 0;
+		uint64_t found = size;
+		in.clear();
+		in.seekg((std::streamoff)(cuts[i] - 1), std::ios::beg);
+		char buffer[64 * 1024];
+		uint64_t position = cuts[i] - 1;
+		while (found == size && in.good())
+		{
+			in.read(buffer, sizeof(buffer));
+			size_t n = (size_t)in.gcount();
+			for (size_t b = 0; b < n; b++)
+			{
+				if (buffer[b] == '\n' && !quoted)
+				{
+					found = position + b + 1;
+					break;
+				}
+				if (buffer[b] == '"' && position + b >= cuts[i])
+				{
+					quoted = !quoted;
+				}
+			}
+			position += n;
+		}
+		bounds.push_back(std::max(std::min(found, size), bounds.back()));
+	}
+	bounds.push_back(size);
+	return true;
+}
+
+void CSV_Utility::RunTasks(const size_t tasks, const size_t threads, const std::function<void(const size_t)>& task)
+{
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < tasks; i = next++)
+		{
+			task(i);
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (size_t i = 1; i < std::min(threads, tasks); i++)
+	{
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& thread : pool)
+	{
+		thread.join();
+	}
+}
+
+bool CSV_Utility::IngestLine(std::string& line, const bool first)
+{
+	// Trim in place, the view only ever loses a prefix and a suffix.
+	std::string_view view(line);
+	CSV_ReadAhead::Normalize(view, first, mIngest);
+	if (view.size() != line.size())
+	{
+		line.assign(view.data(), view.size());
+	}
+
+	return IsIngestValid(line);
+}
+
+bool CSV_Utility::ReadRecord(std::istream& stream, std::string& record, const char delimiter)
+{
+	if (!std::getline(stream, record))
+	{
+		return false;
+	}
+
+	// Join lines while the row is inside a quoted field.
+	if (CSV_InQuotes(record, delimiter, false))
+	{
+		std::string line;
+		bool open = true;
+		while (open && std::getline(stream, line))
+		{
+			record.push_back('\n');
+			record += line;
+			open = CSV_InQuotes(line, delimiter, true);
+		}
+	}
+	return true;
+}
+
+bool CSV_Utility::ReadHeader(const std::string& filename, std::string& header, uint64_t& bodyOffset)
+{
+	header.clear();
+	bodyOffset = 0;
+	std::ifstream in(filename, std::ios::in | std::ios::binary);
+	if (!in.is_open())
+	{
+		return false;
+	}
+
+	// The body starts past the raw header, byte order mark and line ending included.
+	ReadRecord(in, header, dCSVFileInfo.delimiter);
+	bodyOffset = in.eof() ? (uint64_t)header.size() : (uint64_t)header.size() + 1;
+	return IngestLine(header, true);
+}
+
+bool CSV_Utility::IsIngestValid(std::string_view line)
+{
+	if ((mIngest & INGEST_OPTION::INGEST_VALIDATE_UTF8) && !IsValidUTF8(line.data(), line.size()))
+	{
+		CSV_LOG(CSV_LOG_WARNING, EVENT_INVALID_UTF8, mUser, "ReadRow", dCSVFileInfo.filename, 0);
+		return false;
+	}
+
+	return true;
+}
+
+bool CSV_Utility::IsValidUTF8(const char* data, const size_t size)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+	size_t i = 0;
+	while (i < size)
+	{
+		// Skip ASCII sixteen bytes at a time, checking the high bit of every byte with two word loads.
+		if (i + 16 <= size)
+		{
+			uint64_t words[2];
+			memcpy(words, bytes + i, sizeof(words));
+			if (((words[0] | words[1]) & 0x8080808080808080ULL) == 0)
+			{
+				i += 16;
+				continue;
+			}
+		}
+
+		unsigned char c = bytes[i];
+		if (c < 0x80)
+		{
+			i++;
+			continue;
+		}
+
+		// Lead byte of a multi byte sequence, rejecting overlong forms, surrogates and values past U+10FFFF.
+		size_t need = 0;
+		unsigned char low = 0x80;
+		unsigned char high = 0xBF;
+		if (c >= 0xC2 && c <= 0xDF)
+		{
+			need = 1;
+		}
+		else if (c >= 0xE0 && c <= 0xEF)
+		{
+			need = 2;
+			low = c == 0xE0 ? 0xA0 : 0x80;
+			high = c == 0xED ? 0x9F : 0xBF;
+		}
+		else if (c >= 0xF0 && c <= 0xF4)
+		{
+			need = 3;
+			low = c == 0xF0 ? 0x90 : 0x80;
+			high = c == 0xF4 ? 0x8F : 0xBF;
+		}
+		else
+		{
+			return false;
+		}
+
+		if (size - i - 1 < need || bytes[i + 1] < low || bytes[i + 1] > high)
+		{
+			return false;
+		}
+		for (size_t k = 2; k <= need; k++)
+		{
+			if ((bytes[i + k] & 0xC0) != 0x80)
+			{
+				return false;
+			}
+		}
+		i += need + 1;
+	}
+
+	return true;
+}
+
+template<typename T>
+int64_t CSV_Utility::ReadNumericValues(const int column, std::vector<T>& values, const T missing)
+{
+	// make sure column is more than 0
+	if (column < 1)
+	{
+		CSV_LOG(CSV_LOG_ERROR, EVENT_INVALID_COLUMN, mUser, "ReadNumericColumn", "", column);
+		return -1;
+	}
+
+	if (dCSVFileInfo.filename.empty())
+	{
+		return -1;
+	}
+
+	// Make sure rows written through this utility are in the file.
+	if (mFile.is_open())
+	{
+		mFile.flush();
+	}
+
+	CSV_ReadAhead file(mReadAheadSize, mReadAheadDepth, mIngest, dCSVFileInfo.delimiter);
+	if (!file.Open(dCSVFileInfo.filename))
+	{
+		return -1;
+	}
+
+	// Skip the column headers.
+	std::string_view line;
+	file.GetLine(line);
+
+	// Decode each cell straight from the read buffer, no strings are made for the cells.
+	int64_t invalid = 0;
+	const char delimiter = dCSVFileInfo.delimiter;
+	std::string unescaped;
+	while (file.GetLine(line))
+	{
+		// Rows with quotes go through the tokenizer, the rest are cut with memchr.
+		std::string_view field;
+		bool found = false;
+		if (line.find('"') != std::string_view::npos)
+		{
+			unescaped.clear();
+			size_t position = 0;
+			for (int c = 1; c <= column && position <= line.size(); c++)
+			{
+				field = CSV_NextField(line, position, delimiter, unescaped);
+				found = c == column;
+			}
+		}
+		else
+		{
+			const char* start = line.data();
+			const char* end = line.data() + line.size();
+			for (int c = 1; c < column && start != nullptr; c++)
+			{
+				start = static_cast<const char*>(memchr(start, delimiter, (size_t)(end - start)));
+				start = start != nullptr ? start + 1 : nullptr;
+			}
+			if (start != nullptr)
+			{
+				const char* next = static_cast<const char*>(memchr(start, delimiter, (size_t)(end - start)));
+				field = std::string_view(start, (size_t)((next != nullptr ? next : end) - start));
+				found = true;
+			}
+		}
+
+		T value = missing;
+		if (found)
+		{
+			if (!ParseNumber(field, value))
+			{
+				value = missing;
+				invalid++;
+			}
+		}
+		else
+		{
+			invalid++;
+		}
+		values.push_back(value);
+	}
+
+	file.Close();
+	return invalid;
+}
+
+size_t CSV_Utility::ParseDigits(const char* data, const size_t size, uint64_t& value)
+{
+	size_t i = 0;
+
+	// Eight digits at a time: check all eight are digits, then combine them with three multiplies.
+	while (i + 8 <= size)
+	{
+		uint64_t chunk;
+		memcpy(&chunk, data + i, sizeof(chunk));
+		if ((chunk & 0xF0F0F0F0F0F0F0F0ULL) != 0x3030303030303030ULL ||
+			((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) != 0x3030303030303030ULL)
+		{
+			break;
+		}
+
+		chunk -= 0x3030303030303030ULL;
+		chunk = (chunk * 10) + (chunk >> 8);
+		chunk = (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+				(((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+		value = value * 100000000ULL + chunk;
+		i += 8;
+	}
+
+	// The rest one at a time.
+	while (i < size && data[i] >= '0' && data[i] <= '9')
+	{
+		value = value * 10 + (uint64_t)(data[i] - '0');
+		i++;
+	}
+	return i;
+}
+
+std::string_view CSV_Utility::TrimNumber(std::string_view field)
+{
+	while (!field.empty() && isspace((unsigned char)field.front()))
+	{
+		field.remove_prefix(1);
+	}
+	while (!field.empty() && isspace((unsigned char)field.back()))
+	{
+		field.remove_suffix(1);
+	}
+
+	// Only a single '+' goes, "+-5" is still not a number.
+	if (field.size() > 1 && field[0] == '+' && field[1] != '+' && field[1] != '-')
+	{
+		field.remove_prefix(1);
+	}
+	return field;
+}
+
+bool CSV_Utility::ParseNumber(std::string_view field, int64_t& value)
+{
+	bool negative = !field.empty() && field[0] == '-';
+	size_t sign = negative ? 1 : 0;
+
+	// Up to 18 digits can't overflow, anything longer or unusual goes through from_chars after a trim.
+	uint64_t digits = 0;
+	size_t count = field.size() > sign && field.size() - sign <= 18 ? ParseDigits(field.data() + sign, field.size() - sign, digits) : 0;
+	if (count > 0 && sign + count == field.size())
+	{
+		value = negative ? -(int64_t)digits : (int64_t)digits;
+		return true;
+	}
+
+	std::string_view number = TrimNumber(field);
+	auto result = std::from_chars(number.data(), number.data() + number.size(), value);
+	return result.ec == std::errc() && result.ptr == number.data() + number.size() && !number.empty();
 }
 
-void CSV_Utility::CatchFailReason()
+bool CSV_Utility::ParseNumber(std::string_view field, double& value)
 {
-	if (mFile.eof()) 
-	{ 
-		printf("Eof bit set.\n"); 
+	// Powers of ten a double holds exactly.
+	static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+									1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	bool negative = !field.empty() && field[0] == '-';
+	size_t i = negative ? 1 : 0;
+
+	// Plain decimals with at most 15 significant digits are exact as digits / 10^n.
+	uint64_t digits = 0;
+	size_t whole = field.size() - i <= 32 ? ParseDigits(field.data() + i, field.size() - i, digits) : 0;
+	i += whole;
+	size_t fraction = 0;
+	if (i < field.size() && field[i] == '.')
+	{
+		fraction = ParseDigits(field.data() + i + 1, field.size() - i - 1, digits);
+		i += fraction + 1;
 	}
-	else if (mFile.bad()) 
-	{ 
-		printf("Bad bit set.\n"); 
+	if (i == field.size() && whole + fraction > 0 && whole + fraction <= 15)
+	{
+		double result = (double)digits / powers[fraction];
+		value = negative ? -result : result;
+		return true;
 	}
-	else if (mFile.fail()) 
-	{ 
-		printf("Fail bit set.\n"); 
+
+	// Exponents, long mantissas, a leading '+', surrounding spaces and everything else.
+	std::string_view number = TrimNumber(field);
+	auto result = std::from_chars(number.data(), number.data() + number.size(), value);
+	return result.ec == std::errc() && result.ptr == number.data() + number.size() && !number.empty();
+}
+
+uint64_t CSV_Utility::HashBytes(std::string_view data)
+{
+	// FNV-1a, so partitions do not line up with the buckets of std::hash based containers.
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char c : data)
+	{
+		hash ^= c;
+		hash *= 1099511628211ULL;
 	}
-	else 
-	{ 
-		printf("Unknown failure.\n"); 
+	return hash;
+}
+
+void CSV_Utility::KeyOf(std::string_view line, const std::vector<int>& keyColumns, const char delimiter, std::string& key)
+{
+	key.clear();
+	thread_local std::string unescaped;
+	for (size_t k = 0; k < keyColumns.size(); k++)
+	{
+		// Walk to the key column, a missing column is an empty value.
+		unescaped.clear();
+		std::string_view field;
+		size_t position = 0;
+		for (int c = 1; c <= keyColumns[k]; c++)
+		{
+			field = position <= line.size() ? CSV_NextField(line, position, delimiter, unescaped) : std::string_view();
+		}
+
+		// Unit separator between the parts of a compound key.
+		if (k > 0)
+		{
+			key.push_back('\x1F');
+		}
+		key.append(field.data(), field.size());
 	}
 }
 
-void CSV_Utility::UpdateFileInfo()
+int64_t CSV_Utility::DiffStreams(CSV_ReadAhead& oldRows, CSV_ReadAhead& newRows, const std::vector<int>& keyColumns, 
+								 const char delimiter, std::ostream& out)
 {
-	if (!dCSVFileInfo.filename.empty())
+	// Load the old rows, indexed both by the hash of their bytes and by their key. Old rows sharing
+	// a key are chained in file order, byKey holds the first and last row of each chain.
+	std::vector<std::string> rows;
+	std::vector<size_t> sameKey;
+	std::unordered_multimap<uint64_t, size_t> byContent;
+	std::unordered_map<std::string, std::pair<size_t, size_t>> byKey;
+	std::string_view line;
+	std::string key;
+	while (oldRows.GetLine(line))
 	{
-		dCSVFileInfo.col_names.clear();
-		GetColumnHeaders(dCSVFileInfo.col_names);
-		dCSVFileInfo.n_cols = GetNumberOfColumns();
-		dCSVFileInfo.n_rows = GetNumberOfRows();
-		dCSVFileInfo.filesize = GetFileSize();
+		byContent.emplace(HashBytes(line), rows.size());
+		KeyOf(line, keyColumns, delimiter, key);
+		auto inserted = byKey.emplace(key, std::make_pair(rows.size(), rows.size()));
+		if (!inserted.second)
+		{
+			sameKey[inserted.first->second.second] = rows.size();
+			inserted.first->second.second = rows.size();
+		}
+		sameKey.push_back(SIZE_MAX);
+		rows.emplace_back(line);
+	}
+	std::vector<bool> matched(rows.size(), false);
+
+	int64_t changes = 0;
+	std::string buffer;
+	auto emit = [&](const char* change, std::string_view row)
+	{
+		buffer += change;
+		buffer.push_back(delimiter);
+		buffer.append(row.data(), row.size());
+		buffer.push_back('\n');
+		changes++;
+		if (buffer.size() >= 1024 * 1024)
+		{
+			out.write(buffer.data(), (std::streamsize)buffer.size());
+			buffer.clear();
+		}
+	};
+
+	while (newRows.GetLine(line))
+	{
+		// Rows with the same bytes as an old row are unchanged, found without looking at their fields.
+		bool same = false;
+		auto range = byContent.equal_range(HashBytes(line));
+		for (auto it = range.first; it != range.second && !same; ++it)
+		{
+			if (!matched[it->second] && rows[it->second] == line)
+			{
+				matched[it->second] = true;
+				same = true;
+			}
+		}
+		if (same)
+		{
+			continue;
+		}
+
+		// Otherwise the key tells a changed row from an added one, pairing it with the first old row 
+		// of that key nothing matched yet. Matched rows are dropped from the front of the chain.
+		KeyOf(line, keyColumns, delimiter, key);
+		auto found = byKey.find(key);
+		size_t row = SIZE_MAX;
+		if (found != byKey.end())
+		{
+			row = found->second.first;
+			while (row != SIZE_MAX && matched[row])
+			{
+				row = sameKey[row];
+			}
+			found->second.first = row;
+		}
+		if (row != SIZE_MAX)
+		{
+			matched[row] = true;
+			emit("changed", line);
+		}
+		else
+		{
+			emit("added", line);
+		}
+	}
+
+	// Old rows nothing matched were removed.
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		if (!matched[i])
+		{
+			emit("removed", rows[i]);
+		}
 	}
+
+	out.write(buffer.data(), (std::streamsize)buffer.size());
+	out.flush();
+	return out.good() ? changes : -1;
 }
\ No newline at end of file
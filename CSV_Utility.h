@@ -16,12 +16,21 @@
 //          name                        reason included
 //          --------------------        ---------------------------------------
 #if defined _WIN32
+#ifndef		NOMINMAX					// Keep std::min / std::max usable
+#define		NOMINMAX
+#endif
 #include	<windows.h>					// Windows necessary stuff
 #include	<direct.h>					// Make Directory
+#include	<io.h>						// _open / _commit
+#include	<fcntl.h>					// Open flags
 #else
 #include	<sys/types.h>
 #include	<sys/stat.h>
 #include	<unistd.h>
+#include	<fcntl.h>					// open / fsync
+#if defined(__linux__)
+#include	<sys/sendfile.h>			// sendfile
+#endif
 #endif
 //
 #include <fstream>						// File Stream
@@ -31,9 +40,32 @@
 #include <string>                       // Strings
 #include <iostream>						// Standard IO
 #include <mutex>						// Data protection
+#include <condition_variable>			// Group commit
+#include <thread>						// Durability thread
 #include <filesystem>					// Checking for file extension
+#include <unordered_map>				// Hash tables
+#include <unordered_set>				// Hash sets
+#include <map>							// Ordered maps
+#include <algorithm>					// Sorting
+#include <cmath>						// Logarithms for sampling
+#include <limits>						// Numeric limits
+#include <random>						// Sampling
+#include <atomic>						// Shared counters for parallel scans
+#include <cstring>						// memchr
+#include <cctype>						// Trimming numbers
+#include <functional>					// Thread pool tasks
+#include <queue>							// Merging partitions in row order
+#include <charconv>						// Row numbers of partitioned rows
 //
 #include "CSV_Info.h"					// CSV Utility Information
+#include "CSV_Log.h"					// Structured logging
+#include "CSV_Schema.h"					// Typed row schemas
+#include "CSV_ReadAhead.h"				// Read ahead line reader
+#include "CSV_RowStore.h"				// Disk backed parse results
+#include "CSV_Pipeline.h"				// Streaming transformation pipelines
+#include "CSV_KeySet.h"					// Key sets for dedup
+#include "CSV_RowCache.h"				// Parsed row cache
+#include "CSV_BatchWorkers.h"			// Formatting batches while writing
 // 
 //	Defines:
 //          name                        reason defined
@@ -41,6 +73,24 @@
 #ifndef     CSV_UTILITY					// Define the csv utility class. 
 #define     CSV_UTILITY
 #endif
+#ifndef     CSV_DEFAULT_BLOCK_ROWS		// Default number of rows per row index block.
+#define     CSV_DEFAULT_BLOCK_ROWS		4096
+#endif
+#ifndef     CSV_DEFAULT_MAX_ERRORS		// Default number of violations Validate stops after.
+#define     CSV_DEFAULT_MAX_ERRORS		1000
+#endif
+#ifndef     CSV_VALIDATE_CHUNK_SIZE		// Size of the file chunks Validate scans in parallel.
+#define     CSV_VALIDATE_CHUNK_SIZE		(8 * 1024 * 1024)
+#endif
+#ifndef     CSV_DEFAULT_MEMORY_BUDGET	// Default memory budget in bytes for large file operations.
+#define     CSV_DEFAULT_MEMORY_BUDGET	(64 * 1024 * 1024)
+#endif
+#ifndef     CSV_JOIN_MAX_DEPTH			// Levels of partitioning Join goes through before joining a partition in memory.
+#define     CSV_JOIN_MAX_DEPTH			4
+#endif
+#ifndef     CSV_WRITE_BATCH_ROWS		// Rows WriteAFullCSV formats into one buffer before writing it.
+#define     CSV_WRITE_BATCH_ROWS		8192
+#endif
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -75,6 +125,8 @@ public:
 	bool ChangeCSVUtilityMode(const UTILITY_MODE mode);
 
 	//! @brief Write out column headers.
+	//! @note In an append mode the headers are written after any rows already in the file, use
+	//!		  PrependHeader to insert them in front of the rows instead.
 	//! @param names - [in] - vector of strings to write as columns headers
 	//! @return int: -1 on error, else the number of columns successfully written. 
 	int WriteColumnHeaders(const std::vector<std::string>& names);
@@ -86,6 +138,8 @@ public:
 	template<typename T>
 	int WriteRow(const std::vector<T>& values)
 	{
+		std::unique_lock<std::mutex> lock(mWriteLock);
+
 		// Make sure file is open and we are in a write mode
 		if (!mFile.is_open() || (mMode != UTILITY_MODE::WRITE_APPEND && mMode != UTILITY_MODE::WRITE_TRUNC && 
 								mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
@@ -96,22 +150,23 @@ public:
 		// Verify file handle is good.  
 		if (mFile.good() || mFile.eof())
 		{
-			// write the values to the file, adding the delimited in between. 
+			// Format the values into the row buffer, adding the delimiter in between, and write it in one call. 
+			mRowBuffer.clear();
 			int count = 0;
 			for (typename std::vector<T>::const_iterator it = values.begin(); it != values.end(); ++it)
 			{
-				mFile << *it;
-				if (it + 1 != values.end())
+				if (it != values.begin())
 				{
-					mFile << dCSVFileInfo.delimiter;
+					mRowBuffer.push_back(dCSVFileInfo.delimiter);
 				}
+				AppendStreamed(*it);
 				count++;
 			}
-			mFile << "\n";
+			mRowBuffer.push_back('\n');
+			mFile.write(mRowBuffer.data(), (std::streamsize)mRowBuffer.size());
 
-			// Increment the number of rows and return count.
-			dCSVFileInfo.n_rows++;
-			return count;
+			// Count the row against the durability policy and return count.
+			return RowWritten(count, lock);
 		}
 		else
 		{
@@ -126,14 +181,224 @@ public:
 	//! @param values - [in] - A string that contains the read line of data. 
 	//! @param row - [in] - if zero (0), reads current position, else reads specified row. 
 	//! @return bool: True if successful read, false if fail. 
-	bool ReadRow(std::string& values, const int row);
+	bool ReadRow(std::string& values, const int64_t row);
+
+	//! @brief Write a tuple as a row, ex. WriteRow(std::make_tuple(1, 2.5, "name")).
+	//! @note This function is implemented in the header because of the use of template.
+	//! @param values - [in] - the tuple of values to write.
+	//! @return int: -1 on error, else the number of values written. 
+	template<typename... Types>
+	int WriteRow(const std::tuple<Types...>& values)
+	{
+		return std::apply([this](const Types&... args) { return WriteValues(args...); }, values);
+	}
+
+	//! @brief Write a struct registered with CSV_REGISTER_FIELDS as a row.
+	//! @note This function is implemented in the header because of the use of template.
+	//! @param value - [in] - the struct to write.
+	//! @return int: -1 on error, else the number of values written. 
+	template<typename T, typename = decltype(CSV_StructFields<T>::fields)>
+	int WriteRow(const T& value)
+	{
+		return std::apply([this, &value](const auto&... fields) { return WriteValues(value.*fields...); }, 
+							CSV_StructFields<T>::fields);
+	}
+
+	//! @brief Write the arguments as a row, ex. WriteRow(time, value, "name").
+	//! @note This function is implemented in the header because of the use of template.
+	//!		  Takes two or more values, use the tuple overload for a single value.
+	//! @return int: -1 on error, else the number of values written. 
+	template<typename T1, typename T2, typename... Rest>
+	int WriteRow(const T1& first, const T2& second, const Rest&... rest)
+	{
+		return WriteValues(first, second, rest...);
+	}
+
+	//! @brief Write a typed row using a compile time schema, ex. WriteRow<CSV_Schema<int, double>>(row).
+	//! @note This function is implemented in the header because of the use of template.
+	//!		  The row is formatted straight into a reused buffer using the schema's delimiter. 
+	//! @param row - [in] - the typed row to write.
+	//! @return int: -1 on error, else the number of values written. 
+	template<typename Schema>
+	int WriteRow(const typename Schema::Row& row)
+	{
+		std::unique_lock<std::mutex> lock(mWriteLock);
+
+		// Make sure file is open and we are in a write mode
+		if (!mFile.is_open() || (mMode != UTILITY_MODE::WRITE_APPEND && mMode != UTILITY_MODE::WRITE_TRUNC &&
+								mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+		{
+			return -1;
+		}
+
+		// Verify file handle is good.  
+		if (mFile.good() || mFile.eof())
+		{
+			// Format the row and write it in one call.
+			mRowBuffer.clear();
+			Schema::Format(row, mRowBuffer, mQuote);
+			mRowBuffer.push_back('\n');
+			mFile.write(mRowBuffer.data(), (std::streamsize)mRowBuffer.size());
+
+			// Count the row against the durability policy and return count.
+			return RowWritten((int)Schema::columns, lock);
+		}
+		else
+		{
+			CatchFailReason();
+		}
+
+		// Default return
+		return -1;
+	}
+
+	//! @brief Read a typed row using a compile time schema, ex. ReadRow<CSV_Schema<int, double>>(row, 2).
+	//! @note This function is implemented in the header because of the use of template.
+	//!		  std::string_view columns point into an internal buffer and are valid until the next read.
+	//! @param values - [out] - the typed row to read into.
+	//! @param row - [in] - if zero (0), reads current position, else reads specified row. 
+	//! @return bool: True if the row was read and matches the schema, false if fail. 
+	template<typename Schema>
+	bool ReadRow(typename Schema::Row& values, const int64_t row = 0)
+	{
+		if (!ReadRow(mRowBuffer, row))
+		{
+			return false;
+		}
+
+		return Schema::Parse(mRowBuffer, values);
+	}
+
+	//! @brief Read a range of rows from the file, for pagination.
+	//! @note Seeks to the nearest block when a row index is built, else scans from the top.
+	//! @param values - [out] - vector the read rows are appended to.
+	//! @param start - [in] - the first row to read (starting at 1).
+	//! @param count - [in] - the number of rows to read.
+	//! @return int64_t: -1 on error, else the number of rows read.
+	int64_t ReadRows(std::vector<std::string>& values, const int64_t start, const int64_t count);
+
+	//! @brief Read a row and parse it at the delimiter, the same as ReadRow followed by ParseCSVBuffer.
+	//! @note With a row cache set (see SetRowCache) hot rows are answered from the cache without 
+	//!		  reading or parsing them again.
+	//! @param values - [out] - vector the parsed values are placed into (cleared first).
+	//! @param row - [in] - the row to read (starting at 1).
+	//! @return int: -1 on error, else the number of values parsed.
+	int ReadParsedRow(std::vector<std::string>& values, const int64_t row);
+
+	//! @brief Set the size of the cache of rows parsed by ReadParsedRow.
+	//! @note Off (0) by default. The least recently read rows are evicted past the size. The cache
+	//!		  is emptied when rows are written or updated through this utility, and when the file's 
+	//!		  size or modification time changes on disk.
+	//! @param bytes - [in] - the most bytes of parsed rows to keep, 0 to turn the cache off.
+	//! @return bool: true if successful, else false.
+	bool SetRowCache(const size_t bytes);
+
+	//! @brief Get the row cache counters, for tuning its size.
+	//! @param stats - [out] - hits, misses, evictions, invalidations and the current size.
+	//! @return bool: true if the cache is on, false if it is off.
+	bool GetRowCacheStats(CSVRowCacheStats& stats);
+
+	//! @brief Sample rows in one streaming pass, keeping each row independently with a probability (Bernoulli sampling).
+	//! @note Row 1 is treated as the column headers and never sampled.
+	//! @param values - [out] - vector the sampled rows are appended to, in file order.
+	//! @param probability - [in] - the chance of keeping each row, between 0 and 1.
+	//! @param seed - [in] - seed for the random generator, 0 for a random seed.
+	//! @return int64_t: -1 on error, values is left as it was, else the number of rows sampled.
+	int64_t BernoulliSampleRows(std::vector<std::string>& values, const double probability, const uint64_t seed = 0);
+
+	//! @brief Sample k rows uniformly at random.
+	//! @note With a row index built, the k rows are picked up front and read by seeking to them. 
+	//!		  Without one, a single streaming pass keeps a reservoir of k rows.
+	//!		  Row 1 is treated as the column headers and never sampled.
+	//! @param values - [out] - vector the sampled rows are appended to.
+	//! @param k - [in] - the number of rows to sample.
+	//! @param seed - [in] - seed for the random generator, 0 for a random seed.
+	//! @return int64_t: -1 on error, values is left as it was, else the number of rows sampled.
+	int64_t ReservoirSampleRows(std::vector<std::string>& values, const int64_t k, const uint64_t seed = 0);
+
+	//! @brief Insert a header row in front of the rows of the file.
+	//! @note The body is copied behind the new header by the kernel where supported, and the
+	//!		  new file is swapped in atomically. Requires a write mode.
+	//! @param names - [in] - the column names.
+	//! @return bool: true if successful, else false.
+	bool PrependHeader(const std::vector<std::string>& names);
+
+	//! @brief Replace the header row (row 1) of the file.
+	//! @note If the new header is exactly as long as the old one it is patched in place. Otherwise 
+	//!		  the file is rewritten like PrependHeader. Requires a write mode.
+	//! @param names - [in] - the column names.
+	//! @return bool: true if successful, else false.
+	bool ReplaceHeader(const std::vector<std::string>& names);
+
+	//! @brief Update a single cell of the file.
+	//! @note If the new row is exactly as long as the old one it is overwritten in place. Otherwise 
+	//!		  the edit is held and applied by one rewrite of the file on Flush or CloseFile, and reads 
+	//!		  see the old row until then. Requires a write mode.
+	//! @param row - [in] - the row to update (starting at 1).
+	//! @param column - [in] - the column to update (starting at 1).
+	//! @param value - [in] - the new value.
+	//! @return bool: true if successful, else false.
+	bool UpdateCell(const int64_t row, const int column, const std::string value);
+
+	//! @brief Replace a row of the file.
+	//! @note Same in place and pending behavior as UpdateCell.
+	//! @param row - [in] - the row to update (starting at 1).
+	//! @param values - [in] - the new values of the row.
+	//! @return bool: true if successful, else false.
+	bool UpdateRow(const int64_t row, const std::vector<std::string>& values);
+
+	//! @brief Flush written rows to the file and apply pending row updates.
+	//! @return bool: true if successful, else false.
+	bool Flush();
+
+	//! @brief Build an index of row offsets, one entry per block of rows, for the open file.
+	//! @note ReadRow seeks to the nearest block instead of scanning from the top while the index is valid.
+	//!		  Writing rows or closing the file drops the index. 
+	//! @param blockRows - [in] - the number of rows per block.
+	//! @param zoneMaps - [in] - if true, also record the min, max and null count of each column per block.
+	//!						     Row 1 is treated as the column headers and left out of the statistics.
+	//! @return bool: true if successful, else false.
+	bool BuildRowIndex(const int64_t blockRows = CSV_DEFAULT_BLOCK_ROWS, const bool zoneMaps = false);
+
+	//! @brief Get the row index built by BuildRowIndex.
+	//! @param blocks - [out] - the blocks of the index.
+	//! @return bool: true if an index is built, else false.
+	bool GetRowIndex(std::vector<CSVBlockInfo>& blocks);
+
+	//! @brief Read the rows whose value in a column lies within [low, high], skipping blocks using the zone maps.
+	//! @note Values compare numerically when the bounds and the block's column are numeric, else as strings.
+	//!		  Requires an index built with zone maps.
+	//! @param column - [in] - the column to filter on (starting at 1).
+	//! @param low - [in] - the lowest value to include.
+	//! @param high - [in] - the highest value to include.
+	//! @param rows - [out] - the matching rows as read from the file.
+	//! @return int64_t: -1 on error, else the number of rows found.
+	int64_t ReadRowsInRange(const int column, const std::string low, const std::string high, std::vector<std::string>& rows);
 
 	//! @brief Read a column of data from the file.
+	//! @note Reads every row in one pass from the top, a row without the column gives an empty value.
 	//! @param values - [out] - A vector of strings that contains the read column of data. 
 	//! @param column - [in] - reads specified column. 
 	//! @return bool: True if successful read, false if fail. 
 	bool ReadColumn(std::vector<std::string>& values, const int column);
 
+	//! @brief Read a numeric column of data from the file into a contiguous array, skipping the header row.
+	//! @note Cells are decoded straight from the read buffers, eight digits at a time, with from_chars 
+	//!		  handling exponents and other unusual forms, such as a leading '+' or surrounding spaces. 
+	//!		  No string is made per cell.
+	//! @param column - [in] - reads specified column (starting at 1). 
+	//! @param values - [out] - the decoded values are appended, one per row.
+	//! @param missing - [in] - value stored for empty cells or cells that are not numbers.
+	//! @return int64_t: -1 on error, else the number of cells that were stored as missing.
+	int64_t ReadNumericColumn(const int column, std::vector<double>& values, const double missing = std::numeric_limits<double>::quiet_NaN());
+
+	//! @brief Read an integer column of data from the file into a contiguous array, skipping the header row.
+	//! @param column - [in] - reads specified column (starting at 1). 
+	//! @param values - [out] - the decoded values are appended, one per row.
+	//! @param missing - [in] - value stored for empty cells or cells that are not integers.
+	//! @return int64_t: -1 on error, else the number of cells that were stored as missing.
+	int64_t ReadNumericColumn(const int column, std::vector<int64_t>& values, const int64_t missing = 0);
+
 	//! @brief Remove a row of data from the file.
 	//! @param row - [in] - The number of the row to be removed.
 	//! @return bool: True if successful, false if fail. 
@@ -157,32 +422,201 @@ public:
 	//! @return int: -1 if no file opened, else the number of rows found (including column names)
 	int GetNumberOfRows();
 
+	//! @brief Get the number of rows in the open file, for files with more than 2^31 rows.
+	//! @param rows - [out] - the number of rows found (including column names)
+	//! @return bool: true if successful, false if no file opened or failed.
+	bool GetNumberOfRows(int64_t& rows);
+
 	//! @brief Write a full grouping of data to a CSV file
+	//! @note Rows are formatted with the current delimiter in batches of CSV_WRITE_BATCH_ROWS rows, with 
+	//!		  more than one thread each thread formats a batch and the batches are written in row order.
 	//! @param filename - [in] - char array containing the filename to be opened and written to
 	//! @param values - [in] - a vector of any type to write 
-	//! @return bool: true if successful, else false.  
-	bool WriteAFullCSV(const std::string filename, const std::vector<std::vector<std::string>>& values);
+	//! @param atomic - [in] - if true, write to a temporary file, fsync it and rename it over the file, 
+	//!						   so a crash leaves either the old or the new contents.
+	//! @param threads - [in] - number of threads formatting rows, 0 for the hardware thread count.
+	//! @return bool: true if successful, else false. On failure the temporary file is removed and the
+	//!				  utility is back on its original file, mode and position.  
+	bool WriteAFullCSV(const std::string filename, const std::vector<std::vector<std::string>>& values, const bool atomic = false, 
+						const int threads = 1);
+
+	//! @brief Set the durability policy for rows written to the file.
+	//! @param mode - [in] - DURABILITY_MODE to use.
+	//! @param value - [in] - rows between fsyncs for DURABILITY_ROWS, milliseconds between fsyncs for DURABILITY_INTERVAL.
+	//! @return bool: true if successful, false if the value is invalid for the mode.
+	bool SetDurability(const DURABILITY_MODE mode, const int64_t value = 0);
+
+	//! @brief Make every row written so far durable. 
+	//! @note Writers calling Commit at the same time share a single fsync (group commit).
+	//! @return bool: true if successful, false if the flush or fsync failed.
+	bool Commit();
+
+	//! @brief Set the normalization applied to rows read from files.
+	//! @note Applies to ReadRow, ReadRows, ReadColumn, GetColumnHeaders, the samplers, ParseAnyCSVFile 
+	//!		  and everything reading through CSV_ReadAhead. Defaults to INGEST_DEFAULT.
+	//! @param options - [in] - INGEST_OPTION flags combined with |.
+	//! @return bool: true if successful, false if the flags are not valid.
+	bool SetIngestOptions(const int options);
+
+	//! @brief Set which written fields are put in quotes.
+	//! @note Applies to WriteRow, WriteColumnHeaders and WriteAFullCSV. Defaults to QUOTE_MINIMAL, 
+	//!		  quoting only fields that would otherwise break the row (RFC 4180).
+	//! @param policy - [in] - the QUOTE_POLICY.
+	//! @return bool: true if successful, false if the policy is not valid.
+	bool SetQuotePolicy(const QUOTE_POLICY policy);
+
+	//! @brief Set the memory budget used by operations that can spill to disk (Join, ParseAnyCSVFile).
+	//! @param bytes - [in] - the number of bytes an operation may hold in memory.
+	//! @return bool: true if successful, false if the budget is zero.
+	bool SetMemoryBudget(const size_t bytes);
+
+	//! @brief Set the read ahead buffers used when streaming whole files (ParseAnyCSVFile).
+	//! @param bufferSize - [in] - size of each buffer in bytes.
+	//! @param depth - [in] - number of buffers, at least 2.
+	//! @return bool: true if successful, false if the size is zero or depth is less than 2.
+	bool SetReadAhead(const size_t bufferSize, const int depth);
+
+	//! @brief Hash join two CSV files on a key column and write the result to a new CSV file.
+	//! @note The smaller file is loaded into a hash table and the larger file is streamed against it. 
+	//!		  If the smaller file does not fit in the memory budget, both files are hash partitioned
+	//!		  to temporary files next to the output and joined one partition at a time (grace hash join),
+	//!		  partitions that still don't fit are partitioned again. The output can not be one of the inputs.
+	//!		  Row 1 of each file is treated as the column headers. Output row order is not preserved.
+	//!		  With INGEST_VALIDATE_UTF8 set, a row that is not valid UTF-8 fails the join.
+	//! @param left - [in] - filename of the left CSV file.
+	//! @param right - [in] - filename of the right CSV file.
+	//! @param leftKey - [in] - the key column in the left file (starting at 1).
+	//! @param rightKey - [in] - the key column in the right file (starting at 1).
+	//! @param type - [in] - JOIN_TYPE to perform (inner, left or semi).
+	//! @param output - [in] - filename of the CSV file to write the result to.
+	//! @return bool: true if successful, else false.
+	bool Join(const std::string left, const std::string right, const int leftKey, const int rightKey,
+				const JOIN_TYPE type, const std::string output);
 
 	//! @brief Parse a CSV Buffer.
 	//! @param buffer - [in] - A char buffer to be parsed.
-	//! @param values - [out] - A vector to store the parsed values into.
+	//! @note Quoted fields are unquoted (RFC 4180). Empty fields are kept, "a,,b" gives 3 values and "a," gives 2,
+	//!		  where the old parser skipped them. An empty buffer gives no values.
+	//! @param values - [out] - A vector to store the parsed values into, values are appended.
 	//! @return -1 on error, else the number of values successfully parsed. 
 	int ParseCSVBuffer(char* buffer, std::vector<std::string>& values);
 
 	//! @brief Read in any CSV file and parse it. 
+	//! @note Unbounded by default. Once a budget is set (see SetMemoryBudget) it fails when the
+	//!		  parsed rows pass it, use the CSV_RowStore overload for files that may not fit.
 	//! @param filename - [in] - A string filename to be printed. 
 	//! @param values - [out] - A vector of a vector of strings to store the parsed values into.
 	//! @return -1 on error, else the number of values successfully parsed. 
 	bool ParseAnyCSVFile(const std::string filename, std::vector<std::vector<std::string>>& values);
 
-	//! @brief Prints the current CSV file data contents to console. 
+	//! @brief Read in any CSV file and parse it into a row store. 
+	//! @note Rows stay in memory up to the memory budget (see SetMemoryBudget), past it the store
+	//!		  moves them to a spill file. Check rows.IsSpilled() and rows.MemoryUsed() afterwards,
+	//!		  the spill file is also reported in the file info (see GetFileInfo).
+	//! @param filename - [in] - A string filename to be parsed. 
+	//! @param rows - [out] - the row store to parse into, cleared first.
+	//! @return bool: true if successful, else false. 
+	bool ParseAnyCSVFile(const std::string filename, CSV_RowStore& rows);
+
+	//! @brief Prints the current CSV file data contents to console, copied in large chunks. 
 	void PrintCSVData();
 
-	//! @brief Prints any CSV files data contents to console. 
+	//! @brief Prints any CSV files data contents to console as an aligned table (see RenderCSVFile). 
 	//! @param filename - [in] - A string filename to be printed. 
 	//! @return bool: true if successful, else false. 
 	bool PrintAnyCSVFile(const std::string filename);
 
+	//! @brief Render a CSV file as an aligned table, streaming the rows into large buffered writes.
+	//! @note Column widths come from the first rows rendered. Only the selected rows are read, 
+	//!		  so a head, page or tail of a huge file is cheap.
+	//! @param filename - [in] - A string filename to be rendered. 
+	//! @param options - [in] - rows to render, sizing and output stream.
+	//! @return bool: true if successful, else false. 
+	bool RenderCSVFile(const std::string filename, const CSVRenderOptions& options = CSVRenderOptions());
+
+	//! @brief Check the structure of a CSV file, scanning chunks of the file in parallel.
+	//! @note Rows must have the first row's column count, close every quoted field, end with 
+	//!		  LF or CRLF only and hold valid UTF-8. A quoted field may hold newlines (RFC 4180), so a 
+	//!		  quote left open runs to the end of the file. Scanning stops once maxErrors violations are found.
+	//! @param filename - [in] - A string filename to be checked. 
+	//! @param violations - [out] - the first violations found, in file order.
+	//! @param maxErrors - [in] - the number of violations to stop after, 0 for no limit.
+	//! @param threads - [in] - number of threads to scan with, 0 for the hardware thread count.
+	//! @return int64_t: -1 on error, else the number of violations reported (0 if the file is valid).
+	int64_t Validate(const std::string filename, std::vector<CSVViolation>& violations, 
+					const int64_t maxErrors = CSV_DEFAULT_MAX_ERRORS, const int threads = 0);
+
+	//! @brief Split a CSV file into shards, each starting with the header row.
+	//! @note SPLIT_BY_BYTES and SPLIT_BY_ROWS only look for row ends and copy the byte ranges 
+	//!		  of the shards in parallel. SPLIT_BY_HASH scans ranges of the file in parallel, so rows 
+	//!		  of a shard are grouped by input range rather than in file order.
+	//! @param filename - [in] - A string filename to be split. 
+	//! @param strategy - [in] - SPLIT_STRATEGY to split with.
+	//! @param value - [in] - number of shards (bytes, hash) or rows per shard (rows).
+	//! @param shards - [out] - the shard filenames, named by ShardFileName.
+	//! @param keyColumn - [in] - key column for SPLIT_BY_HASH (starting at 1).
+	//! @param threads - [in] - number of threads, 0 for the hardware thread count.
+	//! @return int: -1 on error, else the number of shards written.
+	int Split(const std::string filename, const SPLIT_STRATEGY strategy, const int64_t value, 
+			std::vector<std::string>& shards, const int keyColumn = 0, const int threads = 0);
+
+	//! @brief Concatenate CSV files with the same columns into one file with a single header row.
+	//! @note Bodies of files whose header matches the first file's are copied file to file without
+	//!		  parsing. Files with the same columns in another order are streamed through a column remap.
+	//! @param inputs - [in] - the files to concatenate, in order.
+	//! @param output - [in] - the file to write, replaced if it exists.
+	//! @return bool: true if successful, false if failed or the columns don't match.
+	bool Concat(const std::vector<std::string>& inputs, const std::string output);
+
+	//! @brief Start a lazy pipeline reading a CSV file with this utility's delimiter, read ahead and ingest settings.
+	//! @note Nothing is read until CSV_Pipeline::Run, see CSV_Pipeline for the steps.
+	//! @param source - [in] - the file to read.
+	//! @return CSV_Pipeline: the pipeline to add steps to.
+	CSV_Pipeline Pipeline(const std::string source);
+
+	//! @brief Compare two snapshots of a CSV file by key and write the rows that were added, removed or changed.
+	//! @note The output has a "change" column (added, removed, changed) followed by the row, new values 
+	//!		  for added and changed rows and old values for removed rows. Rows with unchanged bytes are 
+	//!		  matched by hash without reading their fields. Past the memory budget (see SetMemoryBudget) 
+	//!		  both files are partitioned on the key to disk and the partitions are compared in parallel.
+	//!		  Rows sharing a key are paired in file order: the first changed new row of a key with the first
+	//!		  old row of that key not matched by bytes, and so on. Old rows left over are removed and new
+	//!		  rows left over are added. The output can not be one of the snapshots, and both snapshots
+	//!		  must have the same header row.
+	//! @param oldFile - [in] - the earlier snapshot.
+	//! @param newFile - [in] - the later snapshot.
+	//! @param keyColumns - [in] - the columns that identify a row (starting at 1).
+	//! @param output - [in] - the change set file to write, replaced if it exists.
+	//! @param threads - [in] - number of threads for partitions, 0 for the hardware thread count.
+	//! @return int64_t: -1 on error, else the number of changed rows written.
+	int64_t Diff(const std::string oldFile, const std::string newFile, const std::vector<int>& keyColumns, 
+				const std::string output, const int threads = 0);
+
+	//! @brief Write a CSV file without duplicate rows, keeping the first or last row of each key.
+	//! @note Rows stream through a compact set of key fingerprints, verified against the key bytes 
+	//!		  so a fingerprint collision never drops a row. Kept rows are written in file order. 
+	//!		  If the set passes the memory budget (see SetMemoryBudget), the file is partitioned 
+	//!		  on the key to disk instead and the partitions are deduplicated in parallel.
+	//! @param filename - [in] - A string filename to be deduplicated. 
+	//! @param keyColumns - [in] - the columns that identify a row (starting at 1).
+	//! @param output - [in] - the file to write, replaced if it exists.
+	//! @param keepLast - [in] - true to keep the last row of each key, false to keep the first.
+	//! @param threads - [in] - number of threads for partitions, 0 for the hardware thread count.
+	//! @return int64_t: -1 on error, else the number of rows written, not counting the header.
+	int64_t Distinct(const std::string filename, const std::vector<int>& keyColumns, const std::string output, 
+					const bool keepLast = false, const int threads = 0);
+
+	//! @brief Profile every column of a CSV file in one pass, scanning ranges of the file in parallel.
+	//! @note Distinct counts, quantiles of numeric values and frequent values come from fixed size 
+	//!		  sketches, so memory doesn't grow with the file. Profiles of other files merge with 
+	//!		  CSVColumnProfile::Merge. Profiling this utility's file also attaches the profiles to its 
+	//!		  file info, as of the time of the call.
+	//! @param filename - [in] - A string filename to be profiled. 
+	//! @param info - [out] - the file's information, with a profile per header column in profiles.
+	//! @param threads - [in] - number of threads, 0 for the hardware thread count.
+	//! @return int64_t: -1 on error, else the number of rows profiled, not counting the header.
+	int64_t Profile(const std::string filename, CSVFileInfo& info, const int threads = 0);
+
 	//! @brief Check if the file is at the end.
 	//! @return bool: true if the end, false if not.
 	bool IsEndOfFile();
@@ -200,14 +634,27 @@ public:
 	//! @return bool: true if data is vaid, else false. 
 	bool GetFileInfo(std::string& filename, double size, int columns, int rows);
 
+	//! @brief Get the information for the current file. 
+	//! @param filename - [out] - the current filename opened.
+	//! @param size - [out] - the size of the file in bytes. 
+	//! @param columns - [out] - the number of columns
+	//! @param rows - [out] - the number of rows
+	//! @return bool: true if data is vaid, else false. 
+	bool GetFileInfo(std::string& filename, uint64_t& size, int& columns, int64_t& rows);
+
 	//! @brief Clear the contents of the file
 	//! @return bool: true if successful, false if failed.
 	bool ClearFile();
 
 	//! @brief Get the file size in bytes of the file. 
-	//! @return size_t: The size of the file in bytes.
+	//! @return size_t: The size of the file in bytes, -1 on error. Use GetFileSize(uint64_t&) for files over 4 GB on 32 bit builds.
 	size_t GetFileSize();
 
+	//! @brief Get the file size in bytes of the file. 
+	//! @param size - [out] - The size of the file in bytes.
+	//! @return bool: true if successful, false if no file opened or failed.
+	bool GetFileSize(uint64_t& size);
+
 	//! @brief Opens a file stream
 	//! @return bool: true if successful, false if failed. 
 	bool OpenFile();
@@ -228,9 +675,422 @@ private:
 	//! @brief Update the file information to the data structure
 	void UpdateFileInfo();
 
+	//! @brief Format values into the row buffer with the current delimiter and write them as one row.
+	//! @note This function is implemented in the header because of the use of template.
+	//! @return int: -1 on error, else the number of values written. 
+	template<typename... Values>
+	int WriteValues(const Values&... values)
+	{
+		std::unique_lock<std::mutex> lock(mWriteLock);
+
+		// Make sure file is open and we are in a write mode
+		if (!mFile.is_open() || (mMode != UTILITY_MODE::WRITE_APPEND && mMode != UTILITY_MODE::WRITE_TRUNC &&
+								mMode != UTILITY_MODE::READ_WRITE_APPEND && mMode != UTILITY_MODE::READ_WRITE_TRUNC))
+		{
+			return -1;
+		}
+
+		// Verify file handle is good.  
+		if (mFile.good() || mFile.eof())
+		{
+			// Format every value straight into the buffer, adding the delimiter in between.
+			mRowBuffer.clear();
+			size_t index = 0;
+			((index++ != 0 ? mRowBuffer.push_back(dCSVFileInfo.delimiter) : void(), 
+				AppendFormatted(values)), ...);
+			mRowBuffer.push_back('\n');
+			mFile.write(mRowBuffer.data(), (std::streamsize)mRowBuffer.size());
+
+			// Count the row against the durability policy and return count.
+			return RowWritten((int)sizeof...(Values), lock);
+		}
+		else
+		{
+			CatchFailReason();
+		}
+
+		// Default return
+		return -1;
+	}
+
+	//! @brief Format a value onto the row buffer with CSV_FormatValue, quoted by the quote policy.
+	//! @note This function is implemented in the header because of the use of template.
+	template<typename T>
+	void AppendFormatted(const T& value)
+	{
+		size_t start = mRowBuffer.size();
+		CSV_FormatValue(value, mRowBuffer);
+		CSV_QuoteField(mRowBuffer, start, dCSVFileInfo.delimiter, mQuote);
+	}
+
+	//! @brief Format a value onto the row buffer as the file stream would write it, quoted by the quote policy.
+	//! @note This function is implemented in the header because of the use of template.
+	template<typename T>
+	void AppendStreamed(const T& value)
+	{
+		size_t start = mRowBuffer.size();
+		if constexpr (std::is_convertible_v<const T&, std::string_view>)
+		{
+			std::string_view view = value;
+			mRowBuffer.append(view.data(), view.size());
+		}
+		else
+		{
+			mFieldStream.str(std::string());
+			mFieldStream << value;
+			mRowBuffer += mFieldStream.str();
+		}
+		CSV_QuoteField(mRowBuffer, start, dCSVFileInfo.delimiter, mQuote);
+	}
+
+	//! @brief Count a written row against the durability policy, syncing if the policy requires it.
+	//! @param count - [in] - the number of values written, returned unchanged.
+	//! @param lock - [in] - the held write lock, released before any fsync.
+	//! @param rows - [in] - the number of rows written.
+	//! @return int: count.
+	int RowWritten(const int count, std::unique_lock<std::mutex>& lock, const int64_t rows = 1);
+
+	//! @brief Write rows to the open file, formatting batches of rows on several threads.
+	//! @note Workers started once for the call format batches into a bounded set of reused buffers
+	//!		  while this thread writes the finished ones in row order, one write per batch. Each batch
+	//!		  is counted against the durability policy as it is written.
+	//! @param values - [in] - the rows to write.
+	//! @param threads - [in] - number of threads formatting rows.
+	//! @return bool: true if successful, else false.
+	bool WriteRowBatches(const std::vector<std::vector<std::string>>& values, const size_t threads);
+
+	//! @brief Flush and fsync the rows written so far, sharing the fsync with concurrent callers.
+	//! @return bool: true if successful, false if the flush or fsync failed.
+	bool SyncRows();
+
+	//! @brief Background thread for DURABILITY_INTERVAL, syncs new rows every interval.
+	void DurabilityThread();
+
+	//! @brief Stop the durability thread if it is running.
+	void StopDurabilityThread();
+
+	//! @brief Close the handle used for fsync.
+	void CloseSyncHandle();
+
+	//! @brief fsync a file, or a directory so a rename inside it is durable.
+	//! @param path - [in] - the file or directory to sync.
+	//! @return bool: true if successful, else false.
+	static bool SyncPath(const std::string& path);
+
+	//! @brief Insert or replace the header row, in place if it fits, else through a rewritten file.
+	//! @param names - [in] - the column names.
+	//! @param replace - [in] - true to replace row 1, false to insert in front of it.
+	//! @return bool: true if successful, else false.
+	bool RewriteHeader(const std::vector<std::string>& names, const bool replace);
+
+	//! @brief Rename a rewritten temporary over the open file and reopen it without truncating.
+	//! @note Called with the write lock held and no fsync in progress.
+	//! @param temp - [in] - the temporary file.
+	//! @return bool: true if successful, else false.
+	bool SwapInFile(const std::string& temp);
+
+	//! @brief Append a range of bytes of a file onto another file.
+	//! @note Uses copy_file_range, then sendfile, on Linux so the bytes stay in the kernel. 
+	//!		  Falls back to a buffered copy elsewhere or when those are unsupported.
+	//! @param source - [in] - the file to copy from.
+	//! @param destination - [in] - the file to append to.
+	//! @param offset - [in] - the byte offset in source to start from.
+	//! @param bytes - [in] - the number of bytes to copy, by default up to the end of source.
+	//! @return bool: true if successful, else false.
+	bool CopyFileBytes(const std::string& source, const std::string& destination, const uint64_t offset, 
+						const uint64_t bytes = std::numeric_limits<uint64_t>::max());
+
+	//! @brief Get the filename of a shard written by Split, ex. data.csv -> data_1.csv
+	//! @param filename - [in] - the file being split.
+	//! @param index - [in] - index of the shard, starting at 0.
+	//! @return std::string: the shard filename.
+	static std::string ShardFileName(const std::string& filename, const size_t index);
+
+	//! @brief Cut the body of a file into byte ranges that start on rows.
+	//! @note The quotes of each range are counted in parallel, so each cut knows whether it lands in a 
+	//!		  quoted field and moves past the newlines inside it. This assumes quotes pair up within 
+	//!		  fields as RFC 4180 writes them, a stray quote in an unquoted field can move a cut further.
+	//! @param filename - [in] - the file to cut.
+	//! @param bodyOffset - [in] - offset of the first row to include.
+	//! @param size - [in] - size of the file.
+	//! @param ranges - [in] - number of ranges, at least 1.
+	//! @param threads - [in] - most threads to count quotes with.
+	//! @param bounds - [out] - ranges + 1 offsets, range i runs from bounds[i] to bounds[i + 1].
+	//! @return bool: true if successful, false if the file couldn't be read.
+	static bool RowBounds(const std::string& filename, const uint64_t bodyOffset, const uint64_t size, const size_t ranges, 
+						  const size_t threads, std::vector<uint64_t>& bounds);
+
+	//! @brief Run tasks on a pool of threads, each thread taking the next task until none are left.
+	//! @param tasks - [in] - number of tasks.
+	//! @param threads - [in] - number of threads, the calling thread is one of them.
+	//! @param task - [in] - function run for each task index.
+	static void RunTasks(const size_t tasks, const size_t threads, const std::function<void(const size_t)>& task);
+
+	//! @brief Compare a value against a bound, numerically if both are numbers.
+	//! @param value - [in] - the value to compare.
+	//! @param bound - [in] - the bound to compare against.
+	//! @param numeric - [in] - true to compare as numbers.
+	//! @return int: less than 0 if value is below bound, 0 if equal, more than 0 if above.
+	static int CompareValues(const std::string& value, const std::string& bound, const bool numeric);
+
+	//! @brief Apply the ingest options to a row read from the file.
+	//! @param line - [in/out] - the row, normalized in place.
+	//! @param first - [in] - true if the row is the first row of the file.
+	//! @return bool: true if the row is usable, false if it failed UTF-8 validation.
+	bool IngestLine(std::string& line, const bool first);
+
+	//! @brief Read the column headers of a file through the ingest options.
+	//! @param filename - [in] - the file to read.
+	//! @param header - [out] - row 1, normalized.
+	//! @param bodyOffset - [out] - byte offset of row 2, the file size if there is none.
+	//! @return bool: true if successful, false if the file couldn't be opened or the header failed UTF-8 validation.
+	bool ReadHeader(const std::string& filename, std::string& header, uint64_t& bodyOffset);
+
+	//! @brief Check a row already normalized by CSV_ReadAhead::Normalize against the UTF-8 ingest option.
+	//! @param line - [in] - the row.
+	//! @return bool: true if the row is usable, false if it failed UTF-8 validation.
+	bool IsIngestValid(std::string_view line);
+
+	//! @brief Check that bytes are valid UTF-8.
+	//! @note ASCII runs are checked sixteen bytes at a time.
+	//! @param data - [in] - the bytes to check.
+	//! @param size - [in] - the number of bytes.
+	//! @return bool: true if valid, else false.
+	static bool IsValidUTF8(const char* data, const size_t size);
+
+	//! @brief Decode a numeric column into values of type T.
+	//! @param column - [in] - the column (starting at 1).
+	//! @param values - [out] - the decoded values are appended.
+	//! @param missing - [in] - value stored for cells that fail to decode.
+	//! @return int64_t: -1 on error, else the number of cells stored as missing.
+	template<typename T>
+	int64_t ReadNumericValues(const int column, std::vector<T>& values, const T missing);
+
+	//! @brief Accumulate leading decimal digits into a value, eight at a time where possible.
+	//! @note The eight digit step reads the bytes as a little endian word.
+	//! @param data - [in] - the characters.
+	//! @param size - [in] - the number of characters.
+	//! @param value - [in/out] - the value the digits are added onto.
+	//! @return size_t: the number of digits consumed.
+	static size_t ParseDigits(const char* data, const size_t size, uint64_t& value);
+
+	//! @brief Trim what std::stod accepts around a number and from_chars does not.
+	//! @param field - [in] - the field.
+	//! @return std::string_view: the field without surrounding whitespace and a leading '+'.
+	static std::string_view TrimNumber(std::string_view field);
+
+	//! @brief Parse a whole field as an integer.
+	//! @note Surrounding whitespace and a leading '+' are accepted, like std::stoll.
+	//! @param field - [in] - the field.
+	//! @param value - [out] - the parsed value.
+	//! @return bool: true if the whole field is an integer, else false.
+	static bool ParseNumber(std::string_view field, int64_t& value);
+
+	//! @brief Parse a whole field as a floating point number.
+	//! @note Surrounding whitespace and a leading '+' are accepted, like std::stod.
+	//! @param field - [in] - the field.
+	//! @param value - [out] - the parsed value.
+	//! @return bool: true if the whole field is a number, else false.
+	static bool ParseNumber(std::string_view field, double& value);
+
+	//! @brief Count the fields of a line, ignoring delimiters inside quotes.
+	//! @param line - [in] - the line to count.
+	//! @param delimiter - [in] - delimiting character.
+	//! @return int: the number of fields.
+	static int CountFields(const std::string& line, const char delimiter);
+
+	//! @brief Check the rows starting in one chunk of a file.
+	//! @param filename - [in] - the file to check.
+	//! @param start - [in] - first byte of the chunk, the start of a row. Rows starting in [start, end) belong to it.
+	//! @param end - [in] - byte past the end of the chunk.
+	//! @param delimiter - [in] - delimiting character.
+	//! @param columns - [in] - expected number of columns.
+	//! @param maxErrors - [in] - the number of violations to keep, 0 for no limit.
+	//! @param violations - [out] - violations found, rows numbered from the start of the chunk.
+	//! @return int64_t: -1 on error, else the number of rows starting in the chunk.
+	static int64_t ValidateChunk(const std::string& filename, const uint64_t start, const uint64_t end, const char delimiter,
+								const int columns, const int64_t maxErrors, std::vector<CSVViolation>& violations);
+
+	//! @brief Format one table row onto the end of a buffer.
+	//! @param buffer - [out] - the buffer to append to.
+	//! @param label - [in] - the row label.
+	//! @param labelWidth - [in] - the width the label is padded to.
+	//! @param fields - [in] - the values of the row.
+	//! @param widths - [in] - the column widths.
+	//! @param maxWidth - [in] - the width of columns past the sized ones.
+	static void AppendRenderedRow(std::string& buffer, const std::string& label, const size_t labelWidth, 
+								const std::vector<std::string>& fields, const std::vector<size_t>& widths, const size_t maxWidth);
+
+	//! @brief Read the last lines of a file by walking back from its end.
+	//! @note Lines, not rows, a row with a quoted newline is shown as several.
+	//! @param filename - [in] - the file to read.
+	//! @param count - [in] - the number of lines to read.
+	//! @param ingest - [in] - INGEST_OPTION flags the lines are normalized with.
+	//! @param lines - [out] - the lines, in file order.
+	//! @return bool: true if successful, else false.
+	static bool ReadTailLines(const std::string& filename, const int64_t count, const int ingest, std::vector<std::string>& lines);
+
+	//! @brief Position a stream on the file at the start of a row, using the row index when built.
+	//! @param stream - [in] - a stream on the current file.
+	//! @param row - [in] - the row to seek to (starting at 1).
+	void SeekToRow(std::istream& stream, const int64_t row);
+
+	//! @brief Update a whole row (column 0) or one cell of a row, in place or as a pending edit.
+	//! @param row - [in] - the row to update (starting at 1).
+	//! @param column - [in] - the column to update (starting at 1), 0 to replace the whole row.
+	//! @param values - [in] - the new row values, or the new cell value as the only element.
+	//! @return bool: true if successful, else false.
+	bool UpdateRowData(const int64_t row, const int column, const std::vector<std::string>& values);
+
+	//! @brief Create the random generator for sampling.
+	//! @param seed - [in] - the seed, 0 for a random seed.
+	//! @return std::mt19937_64: the generator.
+	static std::mt19937_64 SampleGenerator(const uint64_t seed);
+
+	//! @brief Drop the row index and the cached rows, the file no longer matches them.
+	void ClearRowIndex();
+
+	//! @brief Split a line at the delimiter, keeping empty fields and removing their quoting (RFC 4180). 
+	//! @note The line is split as given, rows are normalized by the ingest options before they get here.
+	//! @param line - [in] - the line to split.
+	//! @param delimiter - [in] - the delimiting character.
+	//! @param values - [out] - vector the fields are placed into (cleared first).
+	//! @return int: the number of fields found.
+	static int SplitLine(std::string_view line, const char delimiter, std::vector<std::string>& values);
+
+	//! @brief Read a row from a stream, joining the lines of a quoted field that holds newlines.
+	//! @note The row is returned as stored, '\n' where the lines were joined and any '\r' kept, so 
+	//!		  its size plus one is the number of bytes read when it ended on a newline.
+	//! @param stream - [in] - the stream, positioned on the start of a row.
+	//! @param record - [out] - the row, without its final newline.
+	//! @param delimiter - [in] - delimiting character.
+	//! @return bool: true if a row was read, false at the end of the stream.
+	static bool ReadRecord(std::istream& stream, std::string& record, const char delimiter);
+
+	//! @brief Hash bytes with FNV-1a.
+	//! @param data - [in] - the bytes to hash.
+	//! @return uint64_t: the hash.
+	static uint64_t HashBytes(std::string_view data);
+
+	//! @brief Build the key of a row from its key columns, without splitting the rest of the row.
+	//! @param line - [in] - the row.
+	//! @param keyColumns - [in] - the key columns (starting at 1).
+	//! @param delimiter - [in] - delimiting character.
+	//! @param key - [out] - the key values joined by a unit separator.
+	static void KeyOf(std::string_view line, const std::vector<int>& keyColumns, const char delimiter, std::string& key);
+
+	//! @brief Diff the rows of two streams in memory, writing change rows to the output.
+	//! @param oldRows - [in] - open reader on the earlier rows, past any header.
+	//! @param newRows - [in] - open reader on the later rows, past any header.
+	//! @param keyColumns - [in] - the key columns (starting at 1).
+	//! @param delimiter - [in] - delimiting character.
+	//! @param out - [in] - stream the change rows are written to.
+	//! @return int64_t: -1 on error, else the number of change rows written.
+	static int64_t DiffStreams(CSV_ReadAhead& oldRows, CSV_ReadAhead& newRows, const std::vector<int>& keyColumns, 
+								const char delimiter, std::ostream& out);
+
+	//! @brief Deduplicate the rows of a file in memory, writing the kept rows to the output in file order.
+	//! @note Keeping the last row reads the file twice, once to find the last row of each key.
+	//! @param filename - [in] - the file to read.
+	//! @param offset - [in] - byte offset of the first row, past any header.
+	//! @param ingest - [in] - INGEST_OPTION flags for reading the file.
+	//! @param keyColumns - [in] - the key columns (starting at 1).
+	//! @param keepLast - [in] - true to keep the last row of each key, false to keep the first.
+	//! @param numbered - [in] - true if each row is led by its row number and the delimiter, kept in the output.
+	//! @param budget - [in] - bytes the key set may use, 0 for no limit.
+	//! @param out - [in] - stream the kept rows are written to.
+	//! @param overflow - [out] - the file offset the key set passed the budget at, 0 if it stayed within it.
+	//! @return int64_t: -1 on error or past the budget, else the number of rows written.
+	int64_t DistinctRows(const std::string& filename, const std::streamoff offset, const int ingest, 
+						const std::vector<int>& keyColumns, const bool keepLast, const bool numbered, 
+						const size_t budget, std::ostream& out, std::streamoff& overflow);
+
+	//! @brief Get a partition number for a key, independent of the hashing used by std::unordered_map.
+	//! @param key - [in] - the key to partition.
+	//! @param partitions - [in] - the number of partitions.
+	//! @param seed - [in] - 0, or a different value for each level when partitioning a partition again.
+	//! @return size_t: the partition in the range [0, partitions).
+	static size_t PartitionOf(const std::string& key, const size_t partitions, const uint64_t seed = 0);
+
+	//! @brief Build a temporary filename next to a base file.
+	//! @param base - [in] - the file the temporary belongs to.
+	//! @param tag - [in] - a tag naming the operation that owns the file.
+	//! @param index - [in] - index of the temporary file.
+	//! @return std::string: the temporary filename.
+	static std::string TempFileName(const std::string& base, const std::string& tag, const size_t index);
+
+	//! @brief Join a build stream against a probe stream in memory, writing rows to the writer.
+	//! @param build - [in] - stream of rows (no header) loaded into the hash table.
+	//! @param probe - [in] - stream of rows (no header) streamed against the hash table.
+	//! @param buildIsLeft - [in] - true if the build stream holds the left file's rows.
+	//! @param buildKey - [in] - key column of the build rows (starting at 1).
+	//! @param probeKey - [in] - key column of the probe rows (starting at 1).
+	//! @param type - [in] - JOIN_TYPE to perform.
+	//! @param rightCols - [in] - the number of columns in the right file, used to pad unmatched left rows.
+	//! @param writer - [in] - an open CSV_Utility the joined rows are written through.
+	//! @param buildName - [in] - the file the build rows come from, empty if they already went through the ingest options.
+	//! @param probeName - [in] - the file the probe rows come from, empty if they already went through the ingest options.
+	//! @return bool: true if successful, else false.
+	bool HashJoinStreams(std::istream& build, std::istream& probe, const bool buildIsLeft, const int buildKey,
+				const int probeKey, const JOIN_TYPE type, const size_t rightCols, CSV_Utility& writer, 
+				const std::string& buildName, const std::string& probeName);
+
+	//! @brief Join a build stream against a probe stream, partitioning both to temporary files while the build rows don't fit.
+	//! @note Partitions that still don't fit are partitioned again with another seed, up to CSV_JOIN_MAX_DEPTH levels. 
+	//!		  A partition that doesn't shrink (one key) or is past the last level is joined in memory over the budget.
+	//!		  Every temporary file is removed before returning.
+	//! @param build - [in] - stream of rows (no header) on the build side.
+	//! @param probe - [in] - stream of rows (no header) on the probe side.
+	//! @param buildSize - [in] - bytes in the build stream.
+	//! @param buildIsLeft - [in] - true if the build stream holds the left file's rows.
+	//! @param buildKey - [in] - key column of the build rows (starting at 1).
+	//! @param probeKey - [in] - key column of the probe rows (starting at 1).
+	//! @param type - [in] - JOIN_TYPE to perform.
+	//! @param rightCols - [in] - the number of columns in the right file, used to pad unmatched left rows.
+	//! @param writer - [in] - an open CSV_Utility the joined rows are written through.
+	//! @param buildName - [in] - the file the build rows come from, empty if they already went through the ingest options.
+	//! @param probeName - [in] - the file the probe rows come from, empty if they already went through the ingest options.
+	//! @param base - [in] - the file the temporary partition files are named after.
+	//! @param depth - [in] - the partitioning level, 0 for the input files.
+	//! @return bool: true if successful, else false.
+	bool JoinPartitions(std::istream& build, std::istream& probe, const uintmax_t buildSize, const bool buildIsLeft, 
+				const int buildKey, const int probeKey, const JOIN_TYPE type, const size_t rightCols, CSV_Utility& writer, 
+				const std::string& buildName, const std::string& probeName, const std::string& base, const int depth);
+
+	//! @brief Pass a row read by Join through the ingest options, a row that isn't valid UTF-8 fails the join.
+	//! @param line - [in/out] - the row, normalized in place.
+	//! @param source - [in] - the file the row comes from, empty if the row already went through the ingest options.
+	//! @return bool: true if the row can be joined, else false.
+	bool IngestJoinLine(std::string& line, const std::string& source);
+
 	std::string			mUser;					//!< Name for the class when using CPP_Logger
 	CSVFileInfo			dCSVFileInfo;			//!< Current CSV File
 	std::fstream		mFile;					//!< File stream
 	std::string			mExtension;				//!< File Extension
 	UTILITY_MODE		mMode;					//!< Current mode of the utility
+	std::string			mRowBuffer;				//!< Reused buffer for typed row reads and writes
+	std::ostringstream	mFieldStream;			//!< Formats WriteRow values as the file stream would
+	size_t				mMemoryBudget;			//!< Bytes an operation may hold in memory before spilling to disk
+	bool				mBudgetSet;				//!< True once SetMemoryBudget was called, bounds the vector ParseAnyCSVFile
+	size_t				mReadAheadSize;			//!< Size of each read ahead buffer in bytes
+	int					mReadAheadDepth;		//!< Number of read ahead buffers
+	DURABILITY_MODE		mDurability;			//!< Durability policy for written rows
+	int64_t				mDurabilityValue;		//!< Rows or milliseconds between fsyncs
+	std::mutex			mWriteLock;				//!< Serializes rows written to the file
+	std::mutex			mSyncLock;				//!< Protects the group commit state
+	std::condition_variable	mSyncSignal;		//!< Signals a finished fsync or a durability thread stop
+	uint64_t			mWriteTicket;			//!< Number of rows written
+	uint64_t			mSyncedTicket;			//!< Number of rows known durable
+	int64_t				mUnsyncedRows;			//!< Rows written since the last fsync
+	bool				mSyncing;				//!< True while a caller is running the shared fsync
+	bool				mDurabilityStop;		//!< Asks the durability thread to stop
+	int					mSyncHandle;			//!< OS file handle used for fsync, -1 if not open
+	std::thread			mDurabilityThread;		//!< Background fsync thread for DURABILITY_INTERVAL
+	std::vector<CSVBlockInfo>	mRowIndex;		//!< Row offsets and zone maps per block of rows
+	int64_t				mBlockRows;				//!< Number of rows per index block
+	bool				mZoneMaps;				//!< True if the row index holds zone maps
+	std::map<int64_t, std::string>	mPendingEdits;	//!< Updated rows waiting for a rewrite, by row
+	int					mIngest;				//!< INGEST_OPTION flags applied to rows read
+	int					mQuote;					//!< QUOTE_POLICY for fields written
+	CSV_RowCache		mRowCache;				//!< Parsed rows of ReadParsedRow, off unless sized
 };
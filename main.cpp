@@ -4,6 +4,311 @@
 #include <iostream>
 #include "CSV_Utility.h"
 
+// Update cells in place and through the rewrite, then read the rows back.
+static bool TestUpdate()
+{
+    CSV_Utility csv;
+    std::vector<std::vector<std::string>> rows{ {"id", "name", "size"},
+                                                {"1", "alpha", "10"},
+                                                {"2", "beta", "20"},
+    };
+    if (!csv.WriteAFullCSV("test/update.csv", rows))
+    {
+        return false;
+    }
+    csv.SetFileName("test/update.csv");
+    csv.ChangeCSVUtilityMode(UTILITY_MODE::READ_WRITE_APPEND);
+    csv.OpenFile();
+
+    // Same length is patched in place, shorter and longer rows wait for Flush.
+    bool result = csv.UpdateCell(2, 2, "gamma");
+    std::string row;
+    result = result && csv.ReadRow(row, 2) && row == "1,gamma,10";
+    result = result && csv.UpdateCell(3, 2, "b") && csv.UpdateRow(2, { "1", "a much longer name", "100" }) && csv.Flush();
+    result = result && csv.ReadRow(row, 2) && row == "1,a much longer name,100";
+    result = result && csv.ReadRow(row, 3) && row == "2,b,20";
+    csv.CloseFile();
+    return result;
+}
+
+// The whole contents of a file.
+static std::string ReadFile(const std::string filename)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// The lines of a file sorted, for outputs whose row order is not preserved.
+static std::vector<std::string> SortedLines(const std::string filename)
+{
+    std::vector<std::string> lines;
+    std::stringstream contents(ReadFile(filename));
+    for (std::string line; std::getline(contents, line);)
+    {
+        lines.push_back(line);
+    }
+    std::sort(lines.begin(), lines.end());
+    return lines;
+}
+
+// Prepend a header, then replace it in place and through the rewrite, the body stays as it was.
+static bool TestHeader()
+{
+    CSV_Utility csv;
+    if (!csv.WriteAFullCSV("test/header.csv", { {"1", "alpha"}, {"2", "beta"} }))
+    {
+        return false;
+    }
+    csv.SetFileName("test/header.csv");
+    csv.ChangeCSVUtilityMode(UTILITY_MODE::READ_WRITE_APPEND);
+    csv.OpenFile();
+
+    std::string row;
+    bool result = csv.PrependHeader({ "id", "name" }) && csv.ReadRow(row, 1) && row == "id,name";
+    result = result && csv.ReplaceHeader({ "ID", "NAME" }) && csv.ReadRow(row, 1) && row == "ID,NAME";
+    result = result && csv.ReplaceHeader({ "key", "label" }) && csv.ReadRow(row, 1) && row == "key,label";
+    csv.CloseFile();
+    return result && ReadFile("test/header.csv") == "key,label\n1,alpha\n2,beta\n";
+}
+
+// An atomic write replaces the whole file, a failed one leaves the target as it was and no temporary file.
+static bool TestAtomicWrite()
+{
+    CSV_Utility csv;
+    bool result = csv.WriteAFullCSV("test/atomic.csv", { {"a", "b"}, {"1", "2"}, {"3", "4"} }, true)
+                && csv.WriteAFullCSV("test/atomic.csv", { {"a", "b"}, {"5", "6"} }, true)
+                && ReadFile("test/atomic.csv") == "a,b\n5,6\n";
+
+    // A directory in the way of the rename fails the write.
+    std::error_code ec;
+    std::filesystem::create_directory("test/atomic_dir.csv", ec);
+    result = result && !csv.WriteAFullCSV("test/atomic_dir.csv", { {"a", "b"} }, true)
+                && std::filesystem::is_directory("test/atomic_dir.csv")
+                && !std::filesystem::exists("test/atomic_dir.csv.atomic.0.tmp");
+    std::filesystem::remove("test/atomic_dir.csv", ec);
+    return result;
+}
+
+// Split by rows, then concatenate the shards back into the original file.
+static bool TestSplitConcat()
+{
+    CSV_Utility csv;
+    if (!csv.WriteAFullCSV("test/split.csv", { {"id", "v"}, {"1", "a"}, {"2", "b"}, {"3", "c"}, {"4", "d"}, {"5", "e"} }))
+    {
+        return false;
+    }
+
+    std::vector<std::string> shards;
+    bool result = csv.Split("test/split.csv", SPLIT_STRATEGY::SPLIT_BY_ROWS, 2, shards) == 3
+                && ReadFile(shards[0]) == "id,v\n1,a\n2,b\n"
+                && ReadFile(shards[2]) == "id,v\n5,e\n";
+    result = result && csv.Concat(shards, "test/split_concat.csv") 
+                && ReadFile("test/split_concat.csv") == ReadFile("test/split.csv");
+    for (const std::string& shard : shards)
+    {
+        std::remove(shard.c_str());
+    }
+    return result;
+}
+
+// Keep the first and then the last row of each key, in file order.
+static bool TestDistinct()
+{
+    CSV_Utility csv;
+    if (!csv.WriteAFullCSV("test/distinct.csv", { {"id", "v"}, {"1", "a"}, {"2", "b"}, {"1", "c"}, {"3", "d"}, {"2", "e"} }))
+    {
+        return false;
+    }
+
+    bool result = csv.Distinct("test/distinct.csv", { 1 }, "test/distinct_out.csv") == 3
+                && ReadFile("test/distinct_out.csv") == "id,v\n1,a\n2,b\n3,d\n";
+    result = result && csv.Distinct("test/distinct.csv", { 1 }, "test/distinct_out.csv", true) == 3
+                && ReadFile("test/distinct_out.csv") == "id,v\n1,c\n3,d\n2,e\n";
+    return result;
+}
+
+// One row changed, one removed and one added. Snapshots with different headers fail.
+static bool TestDiff()
+{
+    CSV_Utility csv;
+    if (!csv.WriteAFullCSV("test/diff_old.csv", { {"id", "v"}, {"1", "x"}, {"2", "y"}, {"3", "z"} })
+        || !csv.WriteAFullCSV("test/diff_new.csv", { {"id", "v"}, {"1", "x"}, {"2", "Y"}, {"4", "w"} })
+        || !csv.WriteAFullCSV("test/diff_other.csv", { {"id", "value"}, {"1", "x"} }))
+    {
+        return false;
+    }
+
+    std::vector<std::string> expected{ "added,4,w", "change,id,v", "changed,2,Y", "removed,3,z" };
+    bool result = csv.Diff("test/diff_old.csv", "test/diff_new.csv", { 1 }, "test/diff_out.csv") == 3
+                && SortedLines("test/diff_out.csv") == expected;
+    return result && csv.Diff("test/diff_old.csv", "test/diff_other.csv", { 1 }, "test/diff_out.csv") == -1;
+}
+
+// Inner, left and semi joins of the same files, key 3 matches twice and keys 1 and 4 not at all.
+static bool TestJoin()
+{
+    CSV_Utility csv;
+    if (!csv.WriteAFullCSV("test/join_left.csv", { {"id", "name"}, {"1", "a"}, {"2", "b"}, {"3", "c"} })
+        || !csv.WriteAFullCSV("test/join_right.csv", { {"key", "size"}, {"2", "20"}, {"3", "30"}, {"3", "31"}, {"4", "40"} }))
+    {
+        return false;
+    }
+
+    std::vector<std::string> inner{ "2,b,2,20", "3,c,3,30", "3,c,3,31", "id,name,key,size" };
+    std::vector<std::string> left{ "1,a,,", "2,b,2,20", "3,c,3,30", "3,c,3,31", "id,name,key,size" };
+    std::vector<std::string> semi{ "2,b", "3,c", "id,name" };
+    bool result = csv.Join("test/join_left.csv", "test/join_right.csv", 1, 1, JOIN_TYPE::INNER_JOIN, "test/join_out.csv")
+                && SortedLines("test/join_out.csv") == inner;
+    result = result && csv.Join("test/join_left.csv", "test/join_right.csv", 1, 1, JOIN_TYPE::LEFT_JOIN, "test/join_out.csv")
+                && SortedLines("test/join_out.csv") == left;
+    result = result && csv.Join("test/join_left.csv", "test/join_right.csv", 1, 1, JOIN_TYPE::SEMI_JOIN, "test/join_out.csv")
+                && SortedLines("test/join_out.csv") == semi;
+    return result;
+}
+
+#ifdef CSV_TEST_LARGE_FILE
+#include <fstream>
+
+// A sparse file past 4 GB: the header, 72 lines of 64 MB holes, then one last row.
+static void TestLargeFile()
+{
+    const int64_t holes = 72;
+    const int64_t hole = 64LL * 1024 * 1024;
+    {
+        std::ofstream out("test/large.csv", std::ios::out | std::ios::trunc | std::ios::binary);
+        out << "id,value\n";
+        for (int64_t i = 1; i <= holes; i++)
+        {
+            out.seekp(i * hole);
+            out.put('\n');
+        }
+        out << "last,row\n";
+    }
+    const uint64_t expectedSize = (uint64_t)(holes * hole) + 1 + 9;
+    const int64_t expectedRows = holes + 2;
+
+    CSV_Utility csv;
+    csv.SetFileName("test/large.csv");
+    csv.ChangeCSVUtilityMode(UTILITY_MODE::READ);
+    csv.OpenFile();
+
+    uint64_t size = 0;
+    int64_t rows = 0;
+    std::string last;
+    bool sized = csv.GetFileSize(size) && size == expectedSize;
+    bool counted = csv.GetNumberOfRows(rows) && rows == expectedRows;
+    bool read = csv.ReadRow(last, expectedRows) && last == "last,row";
+    printf("\tGetFileSize:     %s (%llu bytes)\n", sized ? "passed" : "failed", (unsigned long long)size);
+    printf("\tGetNumberOfRows: %s (%lld rows)\n", counted ? "passed" : "failed", (long long)rows);
+    printf("\tReadRow:         %s (\"%s\")\n", read ? "passed" : "failed", last.c_str());
+
+    csv.CloseFile();
+    std::remove("test/large.csv");
+}
+#endif
+
+#ifdef CSV_BENCHMARK
+#include <chrono>
+
+// Rows written and read by each benchmark.
+#define BENCH_ROWS 1000000
+
+// Seconds since start.
+static double Elapsed(const std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Typed schema rows against string rows split by ParseCSVBuffer, on the same file.
+static void BenchSchemaRows()
+{
+    using Schema = CSV_Schema<int, double, std::string>;
+    CSV_Utility csv;
+    csv.SetFileName("test/bench_schema.csv");
+    csv.ChangeCSVUtilityMode(UTILITY_MODE::WRITE_TRUNC);
+    csv.OpenFile();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_ROWS; i++)
+    {
+        csv.WriteRow<Schema>(Schema::Row(i, i * 0.5, "name"));
+    }
+    csv.CloseFile();
+    printf("\tWriteRow<Schema>:               %.3f s\n", Elapsed(start));
+
+    csv.SetFileName("test/bench_schema.csv");
+    csv.ChangeCSVUtilityMode(UTILITY_MODE::WRITE_TRUNC);
+    csv.OpenFile();
+    start = std::chrono::steady_clock::now();
+    std::vector<std::string> fields(3);
+    for (int i = 0; i < BENCH_ROWS; i++)
+    {
+        fields[0] = std::to_string(i);
+        fields[1] = std::to_string(i * 0.5);
+        fields[2] = "name";
+        csv.WriteRow(fields);
+    }
+    csv.CloseFile();
+    printf("\tWriteRow(std::vector<string>):  %.3f s\n", Elapsed(start));
+
+    // Both readers convert every field, the string path through stoi/stod.
+    csv.SetFileName("test/bench_schema.csv");
+    csv.ChangeCSVUtilityMode(UTILITY_MODE::READ);
+    csv.OpenFile();
+    Schema::Row row;
+    int64_t rows = 0;
+    start = std::chrono::steady_clock::now();
+    while (csv.ReadRow<Schema>(row))
+    {
+        rows++;
+    }
+    csv.CloseFile();
+    printf("\tReadRow<Schema>:                %.3f s, %lld rows\n", Elapsed(start), (long long)rows);
+
+    csv.SetFileName("test/bench_schema.csv");
+    csv.OpenFile();
+    std::string line;
+    int total = 0;
+    rows = 0;
+    start = std::chrono::steady_clock::now();
+    while (csv.ReadRow(line, 0) && !line.empty())
+    {
+        fields.clear();
+        csv.ParseCSVBuffer(&line[0], fields);
+        total += std::stoi(fields[0]) + (int)std::stod(fields[1]);
+        rows++;
+    }
+    csv.CloseFile();
+    printf("\tReadRow + ParseCSVBuffer:       %.3f s, %lld rows\n", Elapsed(start), (long long)rows);
+}
+
+// The same rows written raw and with minimal quoting, one field in four needs quotes.
+static void BenchQuoting()
+{
+    std::vector<std::string> fields{ "", "plain text field", "has, a comma", "12345.678" };
+    const QUOTE_POLICY policies[] = { QUOTE_POLICY::QUOTE_NONE, QUOTE_POLICY::QUOTE_MINIMAL };
+    const char* names[] = { "QUOTE_NONE:   ", "QUOTE_MINIMAL:" };
+    for (int p = 0; p < 2; p++)
+    {
+        CSV_Utility csv;
+        csv.SetQuotePolicy(policies[p]);
+        csv.SetFileName("test/bench_quoting.csv");
+        csv.ChangeCSVUtilityMode(UTILITY_MODE::WRITE_TRUNC);
+        csv.OpenFile();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BENCH_ROWS; i++)
+        {
+            fields[0] = std::to_string(i);
+            csv.WriteRow(fields);
+        }
+        csv.CloseFile();
+        printf("\tWriteRow %s         %.3f s\n", names[p], Elapsed(start));
+    }
+}
+#endif
+
 int main()
 {
     CSV_Utility csv;
@@ -92,5 +397,54 @@ int main()
     
     csv.CloseFile();
 
+    printf("\nRound Trip Test:\n");
+    std::vector<std::vector<std::string>> quoted = { {"name", "note", "size"},
+                                                    {"a,b", "say \"hi\"", "5'10\""},
+                                                    {"two\nlines", "", "crlf\r\nend"},
+    };
+    std::vector<std::vector<std::string>> parsed;
+    if (csv.WriteAFullCSV("test/quoted.csv", quoted) && csv.ParseAnyCSVFile("test/quoted.csv", parsed))
+    {
+        printf("\t%s\n", parsed == quoted ? "passed" : "failed");
+    }
+    else
+    {
+        printf("\tfailed to write or read test/quoted.csv\n");
+    }
+
+    printf("\nUpdate Test:\n");
+    printf("\t%s\n", TestUpdate() ? "passed" : "failed");
+
+    printf("\nHeader Test:\n");
+    printf("\t%s\n", TestHeader() ? "passed" : "failed");
+
+    printf("\nAtomic Write Test:\n");
+    printf("\t%s\n", TestAtomicWrite() ? "passed" : "failed");
+
+    printf("\nSplit/Concat Test:\n");
+    printf("\t%s\n", TestSplitConcat() ? "passed" : "failed");
+
+    printf("\nDistinct Test:\n");
+    printf("\t%s\n", TestDistinct() ? "passed" : "failed");
+
+    printf("\nDiff Test:\n");
+    printf("\t%s\n", TestDiff() ? "passed" : "failed");
+
+    printf("\nJoin Test:\n");
+    printf("\t%s\n", TestJoin() ? "passed" : "failed");
+
+#ifdef CSV_TEST_LARGE_FILE
+    printf("\nLarge File Test:\n");
+    TestLargeFile();
+#endif
+
+#ifdef CSV_BENCHMARK
+    printf("\nSchema Benchmark (%d rows):\n", BENCH_ROWS);
+    BenchSchemaRows();
+
+    printf("\nQuoting Benchmark (%d rows):\n", BENCH_ROWS);
+    BenchQuoting();
+#endif
+
     return 0;
 }
\ No newline at end of file